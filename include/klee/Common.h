@@ -21,6 +21,7 @@ namespace klee {
     const char SOLVER_QUERIES_SMT2_FILE_NAME[]="solver-queries.smt2";
     const char ALL_QUERIES_PC_FILE_NAME[]="all-queries.pc";
     const char SOLVER_QUERIES_PC_FILE_NAME[]="solver-queries.pc";
+    const char SOLVER_TELEMETRY_FILE_NAME[]="solver-telemetry.txt";
 
     Solver *constructSolverChain(Solver *coreSolver,
                                  std::string querySMT2LogPath,
@@ -11,6 +11,8 @@
 #define KLEE_CONSTRAINTS_H
 
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+#include "klee/util/RangeFacts.h"
 
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
@@ -26,14 +28,24 @@ public:
   typedef constraints_ty::iterator iterator;
   typedef constraints_ty::const_iterator const_iterator;
 
-  ConstraintManager() {}
+  /// Substitutions implied by the constraints: an equality with a constant
+  /// maps the non-constant side to the constant, any other constraint maps
+  /// to true. The map is persistent, so copies of the manager (e.g. on fork)
+  /// share it.
+  typedef ImmutableMap< ref<Expr>, ref<Expr> > equalities_ty;
+
+  ConstraintManager() : equalitiesStale(false) {}
 
   // create from constraints with no optimization
   explicit
   ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
-    constraints(_constraints) {}
+    constraints(_constraints), equalitiesStale(true) {}
 
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
+  ConstraintManager(const ConstraintManager &cs)
+    : constraints(cs.constraints),
+      equalities(cs.equalities),
+      equalitiesStale(cs.equalitiesStale),
+      rangeFacts(cs.rangeFacts) {}
 
   typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
 
@@ -43,7 +55,17 @@ public:
 
   ref<Expr> simplifyExpr(ref<Expr> e) const;
 
+  /// getRangeFacts - Return the intervals and known bits implied by the
+  /// constraints added through addConstraint.
+  const RangeFacts &getRangeFacts() const {
+    return rangeFacts;
+  }
+
   void addConstraint(ref<Expr> e);
+
+  /// computeRangeFacts - Derive the range facts of constraints given to
+  /// the unoptimized constructor.
+  void computeRangeFacts();
   
   bool empty() const {
     return constraints.empty();
@@ -68,10 +90,21 @@ public:
 private:
   std::vector< ref<Expr> > constraints;
 
+  // substitution map used by simplifyExpr, updated as constraints are added;
+  // only rebuilt (lazily) when the constraints are replaced wholesale
+  mutable equalities_ty equalities;
+  mutable bool equalitiesStale;
+
+  RangeFacts rangeFacts;
+
   // returns true iff the constraints were modified
   bool rewriteConstraints(ExprVisitor &visitor);
 
   void addConstraintInternal(ref<Expr> e);
+
+  void addEquality(ref<Expr> e) const;
+
+  void rebuildEqualities() const;
 };
 
 }
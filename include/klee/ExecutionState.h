@@ -12,7 +12,10 @@
 
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/CopyOnWrite.h"
+#include "klee/Internal/ADT/ImmutableSet.h"
 #include "klee/Internal/ADT/TreeStream.h"
+#include "klee/Internal/Module/Cell.h"
 
 // FIXME: We do not want to be exposing these? :(
 #include "../../lib/Core/AddressSpace.h"
@@ -25,7 +28,6 @@
 namespace klee {
 class Array;
 class CallPathNode;
-struct Cell;
 struct KFunction;
 struct KInstruction;
 class MemoryObject;
@@ -40,7 +42,11 @@ struct StackFrame {
   CallPathNode *callPathNode;
 
   std::vector<const MemoryObject *> allocas;
-  Cell *locals;
+
+  /// The registers of the function. Copies of the frame made when a state
+  /// forks share them until one of the frames writes, so writes must go
+  /// through locals.getWritable().
+  CopyOnWrite<std::vector<Cell> > locals;
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -57,20 +63,32 @@ struct StackFrame {
   MemoryObject *varargs;
 
   StackFrame(KInstIterator caller, KFunction *kf);
-  StackFrame(const StackFrame &s);
-  ~StackFrame();
+};
+
+/// @brief The symbolic objects of a state with their arrays, in creation
+/// order. The list holds a reference to each object.
+class SymbolicList
+  : public std::vector<std::pair<const MemoryObject *, const Array *> > {
+  SymbolicList &operator=(const SymbolicList &);
+
+public:
+  SymbolicList() {}
+  SymbolicList(const SymbolicList &l);
+  ~SymbolicList();
 };
 
 /// @brief ExecutionState representing a path under exploration
 class ExecutionState {
 public:
   typedef std::vector<StackFrame> stack_ty;
+  typedef ImmutableSet<std::pair<const std::string *, unsigned> >
+    covered_lines_ty;
 
 private:
   // unsupported, use copy constructor
   ExecutionState &operator=(const ExecutionState &);
 
-  std::map<std::string, std::string> fnAliases;
+  CopyOnWrite<std::map<std::string, std::string> > fnAliases;
 
 public:
   // Execution - Control Flow specific
@@ -117,6 +135,17 @@ public:
   /// taken to reach/create this state
   TreeOStream symPathOS;
 
+  /// @brief Choices made at the symbolic branches taken to reach this
+  /// state, each with the id of the branching instruction, from which the
+  /// state can be recreated by replaying them. Only recorded with
+  /// --max-resident-states.
+  std::vector<unsigned char> decisions;
+
+  /// @brief Whether this state, or one it was forked from, absorbed other
+  /// states by merging. Its decisions then only describe one of the merged
+  /// paths, so it can not be recreated by replaying them.
+  bool merged;
+
   /// @brief Counts how many instructions were executed since the last new
   /// instruction was covered.
   unsigned instsSinceCovNew;
@@ -127,26 +156,32 @@ public:
   /// @brief Disables forking for this state. Set by user code
   bool forkDisabled;
 
-  /// @brief Set containing which lines in which files are covered by this state
-  std::map<const std::string *, std::set<unsigned> > coveredLines;
+  /// @brief Whether the contents of this state are spilled to disk, see
+  /// StateSwapper
+  bool suspended;
+
+  /// @brief Set containing which lines in which files are covered by this
+  /// state, as (file, line) pairs. It is shared with the states forked from
+  /// this one until either adds a line, so forking does not copy it.
+  covered_lines_ty coveredLines;
 
   /// @brief Pointer to the process tree of the current state
   PTreeNode *ptreeNode;
 
-  /// @brief Ordered list of symbolics: used to generate test cases.
-  //
-  // FIXME: Move to a shared list structure (not critical).
-  std::vector<std::pair<const MemoryObject *, const Array *> > symbolics;
+  /// @brief Ordered list of symbolics: used to generate test cases. Shared
+  /// with forked states until either makes a new symbolic.
+  CopyOnWrite<SymbolicList> symbolics;
 
-  /// @brief Set of used array names for this state.  Used to avoid collisions.
-  std::set<std::string> arrayNames;
+  /// @brief Set of used array names for this state.  Used to avoid
+  /// collisions. Shared with forked states until either adds a name.
+  CopyOnWrite<std::set<std::string> > arrayNames;
 
   std::string getFnAlias(std::string fn);
   void addFnAlias(std::string old_fn, std::string new_fn);
   void removeFnAlias(std::string fn);
 
 private:
-  ExecutionState() : ptreeNode(0) {}
+  ExecutionState() : merged(false), suspended(false), ptreeNode(0) {}
 
 public:
   ExecutionState(KFunction *kf);
@@ -167,6 +202,11 @@ public:
   void addSymbolic(const MemoryObject *mo, const Array *array);
   void addConstraint(ref<Expr> e) { constraints.addConstraint(e); }
 
+  /// Get a hash of the parts of the state that must agree for merge() to
+  /// succeed: the pc, the shape of the stack, the symbolic objects and the
+  /// memory bindings. States with different fingerprints cannot be merged.
+  uint64_t getMergeFingerprint() const;
+
   bool merge(const ExecutionState &b);
   void dumpStack(llvm::raw_ostream &out) const;
 };
@@ -0,0 +1,50 @@
+//===-- CopyOnWrite.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_COPYONWRITE_H
+#define KLEE_COPYONWRITE_H
+
+#include "klee/util/Ref.h"
+
+namespace klee {
+
+  /// CopyOnWrite - A value shared by the copies of its holder, which is
+  /// only copied when a holder sharing it asks to modify it. Copying the
+  /// holder is constant time, whatever the size of the value.
+  template<class T>
+  class CopyOnWrite {
+    struct Shared {
+      unsigned refCount;
+      T value;
+
+      Shared() : refCount(0) {}
+      explicit Shared(const T &_value) : refCount(0), value(_value) {}
+    };
+
+    ref<Shared> shared;
+
+  public:
+    CopyOnWrite() : shared(new Shared()) {}
+    explicit CopyOnWrite(const T &value) : shared(new Shared(value)) {}
+
+    const T &operator*() const { return shared->value; }
+    const T *operator->() const { return &shared->value; }
+
+    /// Return the value for modification, copying it first if it is
+    /// shared with other holders.
+    T &getWritable() {
+      if (shared->refCount > 1)
+        shared = new Shared(shared->value);
+      return shared->value;
+    }
+  };
+
+}
+
+#endif
@@ -10,6 +10,7 @@
 #ifndef KLEE_LIB_INSTRUCTIONINFOTABLE_H
 #define KLEE_LIB_INSTRUCTIONINFOTABLE_H
 
+#include <iosfwd>
 #include <map>
 #include <string>
 #include <set>
@@ -54,6 +55,8 @@ namespace klee {
     std::set<const std::string *, ltstr> internedStrings;
 
   private:
+    InstructionInfoTable();
+
     const std::string *internString(std::string s);
     bool getInstructionDebugInfo(const llvm::Instruction *I,
                                  const std::string *&File, unsigned &Line);
@@ -62,6 +65,13 @@ namespace klee {
     InstructionInfoTable(llvm::Module *m);
     ~InstructionInfoTable();
 
+    /// Write the table for \arg m, which it was built for, to \arg os.
+    void write(llvm::Module *m, std::ostream &os) const;
+
+    /// Read a table written by write() for a module identical to \arg m.
+    /// Return null if \arg is does not describe \arg m.
+    static InstructionInfoTable *read(llvm::Module *m, std::istream &is);
+
     unsigned getMaxID() const;
     const InstructionInfo &getInfo(const llvm::Instruction*) const;
     const InstructionInfo &getFunctionInfo(const llvm::Function*) const;
@@ -11,6 +11,7 @@
 #define KLEE_KINSTRUCTION_H
 
 #include "klee/Config/Version.h"
+#include "klee/util/Ref.h"
 #include "llvm/Support/DataTypes.h"
 #include <vector>
 
@@ -20,6 +21,7 @@ namespace llvm {
 
 namespace klee {
   class Executor;
+  class Expr;
   struct InstructionInfo;
   class KModule;
 
@@ -38,6 +40,15 @@ namespace klee {
     /// Destination register index.
     unsigned dest;
 
+    /// The instruction pre-decoded, for the instructions whose result only
+    /// depends on their operands: \ref binaryOp builds the result of
+    /// arithmetic, logical and integer comparison instructions, and \ref
+    /// castOp the result of integer casts, of \ref width bits. Both are
+    /// null for other instructions.
+    ref<Expr> (*binaryOp)(const ref<Expr> &l, const ref<Expr> &r);
+    ref<Expr> (*castOp)(const ref<Expr> &e, unsigned width);
+    unsigned width;
+
   public:
     virtual ~KInstruction(); 
   };
@@ -53,6 +64,16 @@ namespace klee {
     /// instruction.
     uint64_t offset;
   };
+
+  struct KBranchInstruction : KInstruction {
+    /// targets - The index in KFunction::instructions of the first
+    /// instruction of each successor.
+    unsigned targets[2];
+
+    /// incoming - The index of the branch's block among the incoming blocks
+    /// of the PHI nodes starting each successor, or -1 if there are none.
+    int incoming[2];
+  };
 }
 
 #endif
@@ -12,9 +12,12 @@
 
 #include "klee/Config/Version.h"
 #include "klee/Interpreter.h"
+#include "klee/Internal/Module/Cell.h"
 
+#include <deque>
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 
 namespace llvm {
@@ -31,7 +34,6 @@ namespace llvm {
 }
 
 namespace klee {
-  struct Cell;
   class Executor;
   class Expr;
   class InterpreterHandler;
@@ -94,7 +96,8 @@ namespace klee {
     // Some useful functions to know the address of
     llvm::Function *kleeMergeFn;
 
-    // Our shadow versions of LLVM structures.
+    // Our shadow versions of LLVM structures, built on first use by
+    // buildKFunction.
     std::vector<KFunction*> functions;
     std::map<llvm::Function*, KFunction*> functionMap;
 
@@ -108,7 +111,9 @@ namespace klee {
     std::map<llvm::Constant*, KConstant*> constantMap;
     KConstant* getKConstant(llvm::Constant *c);
 
-    Cell *constantTable;
+    /// The values of constants, indexed by id. Grows as functions using
+    /// new constants are built, without moving the existing cells.
+    std::deque<Cell> constantTable;
 
     // Functions which are part of KLEE runtime
     std::set<const llvm::Function*> internalFunctions;
@@ -117,6 +122,24 @@ namespace klee {
     // Mark function with functionName as part of the KLEE runtime
     void addInternalFunction(const char* functionName);
 
+    static std::string
+    getIntrinsicLibraryPath(const Interpreter::ModuleOptions &opts);
+
+    /// Run the passes and linking which turn the module into the one
+    /// executed.
+    void transform(const Interpreter::ModuleOptions &opts);
+
+    /// Return the path, without extension, of the cache entries for the
+    /// module prepared with \arg opts.
+    std::string getCachePath(const Interpreter::ModuleOptions &opts);
+
+    /// Replace the module with the prepared one cached at \arg path and
+    /// load its instruction infos and \arg assembly. Return false,
+    /// leaving the module untouched, if there is no usable entry.
+    bool loadFromCache(const std::string &path, std::string &assembly);
+
+    void saveToCache(const std::string &path, const std::string &assembly);
+
   public:
     KModule(llvm::Module *_module);
     ~KModule();
@@ -129,6 +152,10 @@ namespace klee {
 
     /// Return an id for the given constant, creating a new one if necessary.
     unsigned getConstantID(llvm::Constant *c, KInstruction* ki);
+
+    /// Build the shadow structure of \arg f, which must be defined and not
+    /// have one already.
+    KFunction *buildKFunction(llvm::Function *f);
   };
 } // End klee namespace
 
@@ -12,8 +12,13 @@
 
 #include "klee/Expr.h"
 
+#include <string>
 #include <vector>
 
+namespace llvm {
+  class raw_ostream;
+}
+
 namespace klee {
   class ConstraintManager;
   class Expr;
@@ -156,6 +161,37 @@ namespace klee {
     /// \return True on success.
     bool mayBeFalse(const Query&, bool &result);
 
+    /// mayBeTrue - Determine, for each expression of a batch, if there is a
+    /// valid assignment for the constraints in which it evaluates to true.
+    ///
+    /// The batch is answered together: each satisfying assignment found
+    /// answers every pending expression it satisfies, and the expressions
+    /// which remain are refuted by a single query on their disjunction. The
+    /// number of queries is thus bounded by the number of satisfiable
+    /// expressions plus one, rather than by the size of the batch.
+    ///
+    /// \param [out] results - On success, results[i] is true iff exprs[i]
+    /// may be true.
+    ///
+    /// \return True on success.
+    bool mayBeTrue(const ConstraintManager &constraints,
+                   const std::vector< ref<Expr> > &exprs,
+                   std::vector<bool> &results);
+
+    /// mustBeTrue - Determine, for each expression of a batch, if it is
+    /// provably true given the constraints.
+    ///
+    /// \sa mayBeTrue(const ConstraintManager&,
+    ///              const std::vector< ref<Expr> >&, std::vector<bool>&)
+    ///
+    /// \param [out] results - On success, results[i] is true iff exprs[i]
+    /// must be true.
+    ///
+    /// \return True on success.
+    bool mustBeTrue(const ConstraintManager &constraints,
+                    const std::vector< ref<Expr> > &exprs,
+                    std::vector<bool> &results);
+
     /// getValue - Compute one possible value for the given expression.
     ///
     /// \param [out] result - On success, a value for the expression in some
@@ -284,6 +320,19 @@ namespace klee {
                                     int minQueryTimeToLog);
 
 
+  /// createTelemetrySolver - Create a solver which forwards all queries to
+  /// the underlying solver, recording their latency, outcome and size under
+  /// the given layer name. Unless \arg innermost is set, queries which do
+  /// not reach another telemetry solver below are counted as hits.
+  ///
+  /// \sa writeSolverTelemetry
+  Solver *createTelemetrySolver(Solver *s, const std::string &name,
+                                bool innermost);
+
+  /// writeSolverTelemetry - Write the measurements of every telemetry solver
+  /// created so far to the given stream.
+  void writeSolverTelemetry(llvm::raw_ostream &os);
+
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
   Solver *createDummySolver();
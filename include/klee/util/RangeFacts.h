@@ -0,0 +1,109 @@
+//===-- RangeFacts.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_RANGEFACTS_H
+#define KLEE_UTIL_RANGEFACTS_H
+
+#include "klee/Expr.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+
+namespace klee {
+
+  /// KnownBitsRange - The abstract value of a bit-vector expression of at
+  /// most 64 bits: an unsigned interval together with the bits known to be
+  /// zero and the bits known to be one. Wider expressions are always
+  /// unconstrained.
+  class KnownBitsRange {
+    unsigned width;
+    uint64_t m_min, m_max;
+    uint64_t knownZero, knownOne;
+
+    void makeEmpty();
+    void normalize();
+
+  public:
+    KnownBitsRange()
+      : width(0), m_min(0), m_max(0), knownZero(0), knownOne(0) {}
+    /// Create the unconstrained value of the given width.
+    explicit KnownBitsRange(unsigned _width);
+    /// Create the exact value of the given width.
+    KnownBitsRange(unsigned _width, uint64_t value);
+    KnownBitsRange(unsigned _width, uint64_t _min, uint64_t _max,
+                   uint64_t _knownZero = 0, uint64_t _knownOne = 0);
+
+    unsigned getWidth() const { return width; }
+    uint64_t getMask() const;
+
+    bool isEmpty() const { return m_min > m_max; }
+    bool isFixed() const { return !isEmpty() && m_min == m_max; }
+    bool isFull() const;
+    bool isTracked() const { return width <= 64; }
+
+    uint64_t min() const { return m_min; }
+    uint64_t max() const { return m_max; }
+    uint64_t getKnownZero() const { return knownZero; }
+    uint64_t getKnownOne() const { return knownOne; }
+    int64_t minSigned() const;
+    int64_t maxSigned() const;
+
+    bool mayEqual(const KnownBitsRange &b) const;
+
+    /// Values in both ranges.
+    KnownBitsRange meet(const KnownBitsRange &b) const;
+    /// Values in either range (over-approximated).
+    KnownBitsRange join(const KnownBitsRange &b) const;
+    /// Values in this range except \arg value (over-approximated).
+    KnownBitsRange exclude(uint64_t value) const;
+
+    bool operator==(const KnownBitsRange &b) const {
+      return width == b.width && m_min == b.m_min && m_max == b.m_max &&
+        knownZero == b.knownZero && knownOne == b.knownOne;
+    }
+    bool operator!=(const KnownBitsRange &b) const { return !(*this == b); }
+  };
+
+  /// RangeFacts - Intervals and known bits for the terms constrained by a
+  /// path condition, derived as constraints are added. The facts are kept in
+  /// a persistent map so copies are cheap and share structure.
+  ///
+  /// The facts are an over-approximation of the values allowed by the
+  /// constraints: an expression the facts decide is decided by the
+  /// constraints as well, assuming the constraints are satisfiable.
+  class RangeFacts {
+  public:
+    typedef ImmutableMap< ref<Expr>, KnownBitsRange > facts_ty;
+
+  private:
+    facts_ty facts;
+
+    void learn(ref<Expr> e, bool value);
+    void restrict(ref<Expr> e, const KnownBitsRange &range);
+
+  public:
+    RangeFacts() {}
+
+    /// Record the facts implied by the (satisfiable) constraint \arg e.
+    void addConstraint(ref<Expr> e);
+
+    /// Compute an over-approximation of the values \arg e may take.
+    KnownBitsRange evaluate(ref<Expr> e) const;
+
+    /// Attempt to decide the boolean expression \arg e.
+    ///
+    /// \param [out] value - The value of \arg e if it is decided.
+    /// \return True iff \arg e is known to always evaluate to \arg value.
+    bool decide(ref<Expr> e, bool &value) const;
+
+    bool empty() const { return facts.empty(); }
+    size_t size() const { return facts.size(); }
+  };
+
+}
+
+#endif
@@ -55,6 +55,11 @@ CoreSolverOptimizeDivides("solver-optimize-divides",
                  llvm::cl::desc("Optimize constant divides into add/shift/multiplies before passing to core SMT solver (default=on)"),
                  llvm::cl::init(true));
 
+llvm::cl::opt<bool>
+UseSolverTelemetry("solver-telemetry",
+                   llvm::cl::desc("Record latency, outcome and query size statistics for each layer of the solver chain (default=off)"),
+                   llvm::cl::init(false));
+
 
 /* Using cl::list<> instead of cl::bits<> results in quite a bit of ugliness when it comes to checking
  * if an option is set. Unfortunately with gcc4.7 cl::bits<> is broken with LLVM2.9 and I doubt everyone
@@ -24,6 +24,9 @@ namespace klee
 	{
 	  Solver *solver = coreSolver;
 
+	  if (UseSolverTelemetry)
+		solver = createTelemetrySolver(solver, "core", true);
+
 	  if (optionIsSet(queryLoggingOptions, SOLVER_PC))
 	  {
 		solver = createPCLoggingSolver(solver,
@@ -43,16 +46,32 @@ namespace klee
 	  }
 
 	  if (UseFastCexSolver)
+	  {
 		solver = createFastCexSolver(solver);
+		if (UseSolverTelemetry)
+		  solver = createTelemetrySolver(solver, "fast-cex", false);
+	  }
 
 	  if (UseCexCache)
+	  {
 		solver = createCexCachingSolver(solver);
+		if (UseSolverTelemetry)
+		  solver = createTelemetrySolver(solver, "cex-cache", false);
+	  }
 
 	  if (UseCache)
+	  {
 		solver = createCachingSolver(solver);
+		if (UseSolverTelemetry)
+		  solver = createTelemetrySolver(solver, "cache", false);
+	  }
 
 	  if (UseIndependentSolver)
+	  {
 		solver = createIndependentSolver(solver);
+		if (UseSolverTelemetry)
+		  solver = createTelemetrySolver(solver, "independent", false);
+	  }
 
 	  if (DebugValidateSolver)
 		solver = createValidatingSolver(solver, coreSolver);
@@ -15,17 +15,27 @@
 #include "klee/Expr.h"
 #include "klee/TimerStatIncrementer.h"
 
+#include <algorithm>
+
 using namespace klee;
 
 ///
 
+static uint64_t hashBinding(const MemoryObject *mo) {
+  return (mo->id + 1) * 0x9e3779b97f4a7c15ULL;
+}
+
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
+  if (!objects.lookup(mo))
+    bindingsHash ^= hashBinding(mo);
   objects = objects.replace(std::make_pair(mo, os));
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
+  if (objects.lookup(mo))
+    bindingsHash ^= hashBinding(mo);
   objects = objects.remove(mo);
 }
 
@@ -158,6 +168,101 @@ bool AddressSpace::resolveOne(ExecutionState &state,
   }
 }
 
+/// The largest number of objects examined with a single batched query
+/// during resolution.
+static const unsigned MaxResolveBatch = 16;
+
+namespace {
+  enum ResolveStep {
+    ResolveContinue,   ///< Keep searching in the same direction.
+    ResolveStop,       ///< No further objects in this direction.
+    ResolveComplete,   ///< All resolutions have been found.
+    ResolveIncomplete  ///< Resolution gave up (solver failure or limit).
+  };
+}
+
+/// Answer queries[index], from the batched \arg results when the batch
+/// was sent to the solver and with an individual query otherwise.
+static bool batchMayBeTrue(ExecutionState &state, TimingSolver *solver,
+                           const std::vector< ref<Expr> > &queries,
+                           const std::vector<bool> &results, unsigned index,
+                           bool &result) {
+  if (!results.empty()) {
+    result = results[index];
+    return true;
+  }
+  return solver->mayBeTrue(state, queries[index], result);
+}
+
+/// Check the objects of \arg batch, in order, as resolutions of \arg p,
+/// using one batched solver query. When \arg forward is false the objects
+/// are in decreasing address order and the search stops once \arg p is
+/// known to be at or above an object; otherwise they are in increasing
+/// order and the search stops once \arg p is known to be below one.
+static ResolveStep resolveBatch(ExecutionState &state, TimingSolver *solver,
+                                ref<Expr> p, ResolutionList &rl,
+                                unsigned maxResolutions,
+                                const ResolutionList &batch, bool forward) {
+  // For each object ask whether p may be in bounds and whether p may be on
+  // the side of the object which keeps the search going.
+  std::vector< ref<Expr> > queries;
+  for (ResolutionList::const_iterator it = batch.begin(), ie = batch.end();
+       it != ie; ++it) {
+    const MemoryObject *mo = it->first;
+    queries.push_back(mo->getBoundsCheckPointer(p));
+    if (forward)
+      queries.push_back(UgeExpr::create(p, mo->getBaseExpr()));
+    else
+      queries.push_back(UltExpr::create(p, mo->getBaseExpr()));
+  }
+
+  // A lone object is queried lazily, so that the fast path below does not
+  // pay for the stop check.
+  std::vector<bool> results;
+  if (batch.size() > 1 && !solver->mayBeTrue(state, queries, results))
+    return ResolveIncomplete;
+
+  for (unsigned i = 0, e = batch.size(); i != e; ++i) {
+    bool mayContinue;
+    if (forward) {
+      if (!batchMayBeTrue(state, solver, queries, results, 2*i+1,
+                          mayContinue))
+        return ResolveIncomplete;
+      if (!mayContinue)
+        return ResolveStop;
+    }
+
+    bool inBounds;
+    if (!batchMayBeTrue(state, solver, queries, results, 2*i, inBounds))
+      return ResolveIncomplete;
+    if (inBounds) {
+      rl.push_back(batch[i]);
+
+      // fast path check
+      unsigned size = rl.size();
+      if (size==1) {
+        bool mustBeTrue;
+        if (!solver->mustBeTrue(state, queries[2*i], mustBeTrue))
+          return ResolveIncomplete;
+        if (mustBeTrue)
+          return ResolveComplete;
+      } else if (size==maxResolutions) {
+        return ResolveIncomplete;
+      }
+    }
+
+    if (!forward) {
+      if (!batchMayBeTrue(state, solver, queries, results, 2*i+1,
+                          mayContinue))
+        return ResolveIncomplete;
+      if (!mayContinue)
+        return ResolveStop;
+    }
+  }
+
+  return ResolveContinue;
+}
+
 bool AddressSpace::resolve(ExecutionState &state,
                            TimingSolver *solver, 
                            ref<Expr> p, 
@@ -179,10 +284,6 @@ bool AddressSpace::resolve(ExecutionState &state,
     // not the first, find a cex assuming not the second...
     // etc.
     
-    // XXX how do we smartly amortize the cost of checking to
-    // see if we need to keep searching up/down, in bad cases?
-    // maybe we don't care?
-    
     // XXX we really just need a smart place to start (although
     // if its a known solution then the code below is guaranteed
     // to hit the fast path with exactly 2 queries). we could also
@@ -199,85 +300,50 @@ bool AddressSpace::resolve(ExecutionState &state,
     MemoryMap::iterator end = objects.end();
       
     MemoryMap::iterator start = oi;
-      
-    // XXX in the common case we can save one query if we ask
-    // mustBeTrue before mayBeTrue for the first result. easy
-    // to add I just want to have a nice symbolic test case first.
-      
+
+    // Objects are examined in batches answered by a single solver
+    // query. The first batch holds only the object containing the
+    // example, which usually settles the resolution on its own; later
+    // batches grow geometrically to amortize the search cost in bad
+    // cases without asking about many objects past the stopping point.
+
     // search backwards, start with one minus because this
-    // is the object that p *should* be within, which means we
-    // get write off the end with 4 queries (XXX can be better,
-    // no?)
-    while (oi!=begin) {
-      --oi;
-      const MemoryObject *mo = oi->first;
+    // is the object that p *should* be within.
+    unsigned batchSize = 1;
+    ResolveStep step = ResolveContinue;
+    while (step == ResolveContinue && oi!=begin) {
       if (timeout_us && timeout_us < timer.check())
         return true;
 
-      // XXX I think there is some query wasteage here?
-      ref<Expr> inBounds = mo->getBoundsCheckPointer(p);
-      bool mayBeTrue;
-      if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
-        return true;
-      if (mayBeTrue) {
-        rl.push_back(*oi);
-        
-        // fast path check
-        unsigned size = rl.size();
-        if (size==1) {
-          bool mustBeTrue;
-          if (!solver->mustBeTrue(state, inBounds, mustBeTrue))
-            return true;
-          if (mustBeTrue)
-            return false;
-        } else if (size==maxResolutions) {
-          return true;
-        }
-      }
-        
-      bool mustBeTrue;
-      if (!solver->mustBeTrue(state, 
-                              UgeExpr::create(p, mo->getBaseExpr()),
-                              mustBeTrue))
-        return true;
-      if (mustBeTrue)
-        break;
+      ResolutionList batch;
+      while (oi!=begin && batch.size() < batchSize)
+        batch.push_back(*--oi);
+      step = resolveBatch(state, solver, p, rl, maxResolutions, batch, false);
+      batchSize = std::min(2 * batchSize, MaxResolveBatch);
     }
+    if (step == ResolveComplete)
+      return false;
+    if (step == ResolveIncomplete)
+      return true;
+
     // search forwards
-    for (oi=start; oi!=end; ++oi) {
-      const MemoryObject *mo = oi->first;
+    batchSize = 1;
+    step = ResolveContinue;
+    oi = start;
+    while (step == ResolveContinue && oi!=end) {
       if (timeout_us && timeout_us < timer.check())
         return true;
 
-      bool mustBeTrue;
-      if (!solver->mustBeTrue(state, 
-                              UltExpr::create(p, mo->getBaseExpr()),
-                              mustBeTrue))
-        return true;
-      if (mustBeTrue)
-        break;
-      
-      // XXX I think there is some query wasteage here?
-      ref<Expr> inBounds = mo->getBoundsCheckPointer(p);
-      bool mayBeTrue;
-      if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
-        return true;
-      if (mayBeTrue) {
-        rl.push_back(*oi);
-        
-        // fast path check
-        unsigned size = rl.size();
-        if (size==1) {
-          bool mustBeTrue;
-          if (!solver->mustBeTrue(state, inBounds, mustBeTrue))
-            return true;
-          if (mustBeTrue)
-            return false;
-        } else if (size==maxResolutions) {
-          return true;
-        }
-      }
+      ResolutionList batch;
+      for (; oi!=end && batch.size() < batchSize; ++oi)
+        batch.push_back(*oi);
+      step = resolveBatch(state, solver, p, rl, maxResolutions, batch, true);
+      batchSize = std::min(2 * batchSize, MaxResolveBatch);
     }
+    if (step == ResolveComplete)
+      return false;
+    if (step == ResolveIncomplete)
+      return true;
   }
 
   return false;
@@ -34,10 +34,16 @@ namespace klee {
   typedef ImmutableMap<const MemoryObject*, ObjectHolder, MemoryObjectLT> MemoryMap;
   
   class AddressSpace {
+    friend class StateSwapper;
+
   private:
     /// Epoch counter used to control ownership of objects.
     mutable unsigned cowKey;
 
+    /// Order independent hash of the bound MemoryObjects, updated as
+    /// bindings are added and removed.
+    uint64_t bindingsHash;
+
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace&); 
     
@@ -52,8 +58,9 @@ namespace klee {
     MemoryMap objects;
     
   public:
-    AddressSpace() : cowKey(1) {}
-    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { }
+    AddressSpace() : cowKey(1), bindingsHash(0) {}
+    AddressSpace(const AddressSpace &b)
+      : cowKey(++b.cowKey), bindingsHash(b.bindingsHash), objects(b.objects) { }
     ~AddressSpace() {}
 
     /// Resolve address to an ObjectPair in result.
@@ -97,6 +104,11 @@ namespace klee {
     /// Remove a binding from the address space.
     void unbindObject(const MemoryObject *mo);
 
+    /// Get a hash of the set of bound MemoryObjects. Address spaces with
+    /// the same bindings, but possibly different contents, have the same
+    /// hash.
+    uint64_t getBindingsHash() const { return bindingsHash; }
+
     /// Lookup a binding from a MemoryObject.
     const ObjectState *findObject(const MemoryObject *mo) const;
 
@@ -47,6 +47,10 @@ namespace stats {
   /// distance to a function return.
   extern Statistic minDistToReturn;
 
+  /// The number of queries decided by the range facts of the state
+  /// without reaching the solver chain.
+  extern Statistic queryRangeHits;
+
 }
 }
 
@@ -19,8 +19,10 @@
 #include "Memory.h"
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
 #else
 #include "llvm/Function.h"
+#include "llvm/Instructions.h"
 #endif
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
@@ -44,24 +46,26 @@ namespace {
 
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
   : caller(_caller), kf(_kf), callPathNode(0), 
+    locals(std::vector<Cell>(kf->numRegisters)),
     minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
 }
 
-StackFrame::StackFrame(const StackFrame &s) 
-  : caller(s.caller),
-    kf(s.kf),
-    callPathNode(s.callPathNode),
-    allocas(s.allocas),
-    minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
-    varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
+/***/
+
+SymbolicList::SymbolicList(const SymbolicList &l)
+  : std::vector<std::pair<const MemoryObject *, const Array *> >(l) {
+  for (const_iterator it = begin(), ie = end(); it != ie; ++it)
+    it->first->refCount++;
 }
 
-StackFrame::~StackFrame() { 
-  delete[] locals; 
+SymbolicList::~SymbolicList() {
+  for (const_iterator it = begin(), ie = end(); it != ie; ++it) {
+    const MemoryObject *mo = it->first;
+    assert(mo->refCount > 0);
+    mo->refCount--;
+    if (mo->refCount == 0)
+      delete mo;
+  }
 }
 
 /***/
@@ -73,27 +77,21 @@ ExecutionState::ExecutionState(KFunction *kf) :
     queryCost(0.), 
     weight(1),
     depth(0),
+    merged(false),
 
     instsSinceCovNew(0),
     coveredNew(false),
     forkDisabled(false),
+    suspended(false),
     ptreeNode(0) {
   pushFrame(0, kf);
 }
 
 ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
-    : constraints(assumptions), queryCost(0.), ptreeNode(0) {}
+    : constraints(assumptions), queryCost(0.), merged(false),
+      suspended(false), ptreeNode(0) {}
 
 ExecutionState::~ExecutionState() {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-  {
-    const MemoryObject *mo = symbolics[i].first;
-    assert(mo->refCount > 0);
-    mo->refCount--;
-    if (mo->refCount == 0)
-      delete mo;
-  }
-
   while (!stack.empty()) popFrame();
 }
 
@@ -113,17 +111,18 @@ ExecutionState::ExecutionState(const ExecutionState& state):
 
     pathOS(state.pathOS),
     symPathOS(state.symPathOS),
+    decisions(state.decisions),
+    merged(state.merged),
 
     instsSinceCovNew(state.instsSinceCovNew),
     coveredNew(state.coveredNew),
     forkDisabled(state.forkDisabled),
+    suspended(false),
     coveredLines(state.coveredLines),
     ptreeNode(state.ptreeNode),
     symbolics(state.symbolics),
     arrayNames(state.arrayNames)
 {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-    symbolics[i].first->refCount++;
 }
 
 ExecutionState *ExecutionState::branch() {
@@ -131,7 +130,7 @@ ExecutionState *ExecutionState::branch() {
 
   ExecutionState *falseState = new ExecutionState(*this);
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
+  falseState->coveredLines = covered_lines_ty();
 
   weight *= .5;
   falseState->weight -= weight;
@@ -153,23 +152,25 @@ void ExecutionState::popFrame() {
 
 void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) { 
   mo->refCount++;
-  symbolics.push_back(std::make_pair(mo, array));
+  symbolics.getWritable().push_back(std::make_pair(mo, array));
 }
 ///
 
 std::string ExecutionState::getFnAlias(std::string fn) {
-  std::map < std::string, std::string >::iterator it = fnAliases.find(fn);
-  if (it != fnAliases.end())
+  std::map < std::string, std::string >::const_iterator it =
+    fnAliases->find(fn);
+  if (it != fnAliases->end())
     return it->second;
   else return "";
 }
 
 void ExecutionState::addFnAlias(std::string old_fn, std::string new_fn) {
-  fnAliases[old_fn] = new_fn;
+  fnAliases.getWritable()[old_fn] = new_fn;
 }
 
 void ExecutionState::removeFnAlias(std::string fn) {
-  fnAliases.erase(fn);
+  if (fnAliases->count(fn))
+    fnAliases.getWritable().erase(fn);
 }
 
 /**/
@@ -187,6 +188,27 @@ llvm::raw_ostream &klee::operator<<(llvm::raw_ostream &os, const MemoryMap &mm)
   return os;
 }
 
+static uint64_t hashCombine(uint64_t h, uint64_t v) {
+  return (h ^ v) * 0x100000001b3ULL;
+}
+
+uint64_t ExecutionState::getMergeFingerprint() const {
+  KInstruction *ki = pc;
+  uint64_t h = hashCombine(0xcbf29ce484222325ULL, (uintptr_t) ki);
+  for (stack_ty::const_iterator it = stack.begin(), ie = stack.end();
+       it != ie; ++it) {
+    KInstruction *caller = it->caller;
+    h = hashCombine(h, (uintptr_t) caller);
+    h = hashCombine(h, (uintptr_t) it->kf);
+  }
+  for (SymbolicList::const_iterator it = symbolics->begin(),
+         ie = symbolics->end(); it != ie; ++it) {
+    h = hashCombine(h, (uintptr_t) it->first);
+    h = hashCombine(h, (uintptr_t) it->second);
+  }
+  return hashCombine(h, addressSpace.getBindingsHash());
+}
+
 bool ExecutionState::merge(const ExecutionState &b) {
   if (DebugLogStateMerge)
     llvm::errs() << "-- attempting merge of A:" << this << " with B:" << &b
@@ -194,9 +216,17 @@ bool ExecutionState::merge(const ExecutionState &b) {
   if (pc != b.pc)
     return false;
 
+  // A PHI node takes the value of the block the state came from, and the
+  // merged state can only keep one of them.
+  if (incomingBBIndex != b.incomingBBIndex && isa<llvm::PHINode>(pc->inst))
+    return false;
+
+  if (suspended || b.suspended)
+    return false;
+
   // XXX is it even possible for these to differ? does it matter? probably
   // implies difference in object states?
-  if (symbolics!=b.symbolics)
+  if (*symbolics != *b.symbolics)
     return false;
 
   {
@@ -213,9 +243,24 @@ bool ExecutionState::merge(const ExecutionState &b) {
       return false;
   }
 
-  std::set< ref<Expr> > aConstraints(constraints.begin(), constraints.end());
-  std::set< ref<Expr> > bConstraints(b.constraints.begin(), 
-                                     b.constraints.end());
+  // Different memory bindings are caught here without walking the
+  // address spaces in most cases.
+  if (addressSpace.getBindingsHash() != b.addressSpace.getBindingsHash())
+    return false;
+
+  // States forked from one another share the constraints added before the
+  // fork as a common prefix; only compare what follows it.
+  ConstraintManager::constraint_iterator prefixA = constraints.begin();
+  ConstraintManager::constraint_iterator prefixB = b.constraints.begin();
+  while (prefixA != constraints.end() && prefixB != b.constraints.end() &&
+         prefixA->get() == prefixB->get()) {
+    ++prefixA;
+    ++prefixB;
+  }
+  std::vector< ref<Expr> > constraintPrefix(constraints.begin(), prefixA);
+
+  std::set< ref<Expr> > aConstraints(prefixA, constraints.end());
+  std::set< ref<Expr> > bConstraints(prefixB, b.constraints.end());
   std::set< ref<Expr> > commonConstraints, aSuffix, bSuffix;
   std::set_intersection(aConstraints.begin(), aConstraints.end(),
                         bConstraints.begin(), bConstraints.end(),
@@ -228,6 +273,10 @@ bool ExecutionState::merge(const ExecutionState &b) {
                       std::inserter(bSuffix, bSuffix.end()));
   if (DebugLogStateMerge) {
     llvm::errs() << "\tconstraint prefix: [";
+    for (std::vector<ref<Expr> >::iterator it = constraintPrefix.begin(),
+                                           ie = constraintPrefix.end();
+         it != ie; ++it)
+      llvm::errs() << *it << ", ";
     for (std::set<ref<Expr> >::iterator it = commonConstraints.begin(),
                                         ie = commonConstraints.end();
          it != ie; ++it)
@@ -311,13 +360,13 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
+      ref<Expr> av = (*af.locals)[i].value;
+      const ref<Expr> &bv = (*bf.locals)[i].value;
       if (av.isNull() || bv.isNull()) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
       } else {
-        av = SelectExpr::create(inA, av, bv);
+        af.locals.getWritable()[i].value = SelectExpr::create(inA, av, bv);
       }
     }
   }
@@ -340,10 +389,14 @@ bool ExecutionState::merge(const ExecutionState &b) {
   }
 
   constraints = ConstraintManager();
+  for (std::vector< ref<Expr> >::iterator it = constraintPrefix.begin(),
+         ie = constraintPrefix.end(); it != ie; ++it)
+    constraints.addConstraint(*it);
   for (std::set< ref<Expr> >::iterator it = commonConstraints.begin(), 
          ie = commonConstraints.end(); it != ie; ++it)
     constraints.addConstraint(*it);
   constraints.addConstraint(OrExpr::create(inA, inB));
+  merged = true;
 
   return true;
 }
@@ -370,7 +423,7 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
 
       out << ai->getName().str();
       // XXX should go through function
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value; 
+      ref<Expr> value = (*sf.locals)[sf.kf->getArgRegister(index++)].value;
       if (isa<ConstantExpr>(value))
         out << "=" << value;
     }
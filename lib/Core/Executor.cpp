@@ -12,13 +12,16 @@
 #include "Context.h"
 #include "CoreStats.h"
 #include "ExternalDispatcher.h"
+#include "FunctionSummaries.h"
 #include "ImpliedValue.h"
 #include "Memory.h"
 #include "MemoryManager.h"
 #include "PTree.h"
 #include "Searcher.h"
+#include "SearcherTrace.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
+#include "StateSwapper.h"
 #include "StatsTracker.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
@@ -85,12 +88,15 @@
 
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/InstIterator.h"
 #else
 #include "llvm/IR/CallSite.h"
+#include "llvm/IR/InstIterator.h"
 #endif
 
 #include <cassert>
 #include <algorithm>
+#include <functional>
 #include <iomanip>
 #include <iosfwd>
 #include <fstream>
@@ -149,6 +155,16 @@ namespace {
                         cl::init(false),
 			cl::desc("Allow calls with symbolic arguments to external functions.  This concretizes the symbolic arguments.  (default=off)"));
 
+  cl::opt<bool>
+  FastForwardConcreteCalls("fast-forward-concrete-calls",
+                           cl::init(false),
+                           cl::desc("Run calls to functions of the module natively when their arguments and all memory are concrete.  Instructions run natively are not covered or counted, and not bounds checked: an out of bounds write corrupts KLEE's heap instead of being reported.  (default=off)"));
+
+  cl::opt<bool>
+  SummarizeFunctions("summarize-functions",
+                     cl::init(false),
+                     cl::desc("Reuse the results of calls with concrete arguments whose execution only depended on concrete memory.  Reused calls are not executed, so their instructions are not covered or counted again.  (default=off)"));
+
   cl::opt<bool>
   DebugPrintInstructions("debug-print-instructions", 
                          cl::desc("Print instructions during execution."));
@@ -166,6 +182,11 @@ namespace {
                      cl::init(true),
                      cl::desc("Simplify equality expressions before querying the solver (default=on)."));
 
+  cl::opt<bool>
+  UseRangeFacts("use-range-facts",
+                cl::init(true),
+                cl::desc("Answer queries decided by the intervals and known bits implied by the path condition without querying the solver (default=on)."));
+
   cl::opt<unsigned>
   MaxSymArraySize("max-sym-array-size",
                   cl::init(0));
@@ -261,6 +282,26 @@ namespace {
   MaxMemoryInhibit("max-memory-inhibit",
             cl::desc("Inhibit forking at memory cap (vs. random terminate) (default=on)"),
             cl::init(true));
+
+  cl::opt<bool>
+  SwapStates("swap-states",
+             cl::desc("Suspend states to disk instead of terminating them when over --max-memory.  Resumed states no longer share expressions with other states, so they may use more memory than before being suspended (default=off)"),
+             cl::init(false));
+
+  cl::opt<unsigned>
+  MaxResidentStates("max-resident-states",
+                    cl::desc("Keep only the branch decisions of states beyond this many, and recreate them by replay when there is room.  Objects get new addresses in recreated states, so a replay which depends on addresses can diverge; the state is then explored normally from the point of divergence (default=0 (off))"),
+                    cl::init(0));
+
+  cl::opt<unsigned>
+  SeedStepInstructions("seed-step-instructions",
+                       cl::desc("Number of instructions a seeded state runs before switching to the next one, unless it forks or terminates first (default=1000)"),
+                       cl::init(1000));
+
+  cl::opt<bool>
+  WriteSearcherTrace("write-searcher-trace",
+                     cl::desc("Write the states added, removed and stepped to searcher.trace, for klee-searcher-bench (default=off)"),
+                     cl::init(false));
 }
 
 
@@ -281,6 +322,11 @@ Executor::Executor(const InterpreterOptions &opts,
     symPathWriter(0),
     specialFunctionHandler(0),
     processTree(0),
+    stateSwapper(0),
+    pristineState(0),
+    searcherTrace(0),
+    summaries(0),
+    constantsBound(false),
     replayOut(0),
     replayPath(0),    
     usingSeeds(0),
@@ -335,7 +381,7 @@ Executor::Executor(const InterpreterOptions &opts,
                          interpreterHandler->getOutputFilename(ALL_QUERIES_PC_FILE_NAME),
                          interpreterHandler->getOutputFilename(SOLVER_QUERIES_PC_FILE_NAME));
   
-  this->solver = new TimingSolver(solver, EqualitySubstitution);
+  this->solver = new TimingSolver(solver, EqualitySubstitution, UseRangeFacts);
 
   memory = new MemoryManager();
 }
@@ -369,7 +415,7 @@ const Module *Executor::setModule(llvm::Module *module,
                        userSearcherRequiresMD2U());
   }
   
-  return module;
+  return kmodule->module;
 }
 
 Executor::~Executor() {
@@ -377,6 +423,7 @@ Executor::~Executor() {
   delete externalDispatcher;
   if (processTree)
     delete processTree;
+  delete stateSwapper;
   if (specialFunctionHandler)
     delete specialFunctionHandler;
   if (statsTracker)
@@ -620,7 +667,14 @@ void Executor::branch(ExecutionState &state,
   unsigned N = conditions.size();
   assert(N);
 
-  if (MaxForks!=~0u && stats::forks >= MaxForks) {
+  if (summaries)
+    summaries->abort(state);
+
+  unsigned choice;
+  if (replayDecision(state, N, choice)) {
+    for (unsigned i=0; i<N; ++i)
+      result.push_back(i == choice ? &state : NULL);
+  } else if (MaxForks!=~0u && stats::forks >= MaxForks) {
     unsigned next = theRNG.getInt32() % N;
     for (unsigned i=0; i<N; ++i) {
       if (i == next) {
@@ -629,6 +683,7 @@ void Executor::branch(ExecutionState &state,
         result.push_back(NULL);
       }
     }
+    recordDecision(state, next);
   } else {
     stats::forks += N-1;
 
@@ -645,6 +700,9 @@ void Executor::branch(ExecutionState &state,
       ns->ptreeNode = res.first;
       es->ptreeNode = res.second;
     }
+
+    for (unsigned i=0; i<N; ++i)
+      recordDecision(*result[i], i);
   }
 
   // If necessary redistribute seeds to match conditions, killing
@@ -654,25 +712,20 @@ void Executor::branch(ExecutionState &state,
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&state);
   if (it != seedMap.end()) {
-    std::vector<SeedInfo> seeds = it->second;
+    std::vector<SeedInfo> seeds;
+    seeds.swap(it->second);
     seedMap.erase(it);
 
     // Assume each seed only satisfies one condition (necessarily true
     // when conditions are mutually exclusive and their conjunction is
     // a tautology).
+    SeedValueCache cache;
     for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
            siie = seeds.end(); siit != siie; ++siit) {
       unsigned i;
-      for (i=0; i<N; ++i) {
-        ref<ConstantExpr> res;
-        bool success = 
-          solver->getValue(state, siit->assignment.evaluate(conditions[i]), 
-                           res);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (res->isTrue())
+      for (i=0; i<N; ++i)
+        if (getSeedValue(state, *siit, conditions[i], cache)->isTrue())
           break;
-      }
       
       // If we didn't find a satisfying condition randomly pick one
       // (the seed will be patched).
@@ -701,6 +754,9 @@ void Executor::branch(ExecutionState &state,
 
 Executor::StatePair 
 Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
+  if (summaries && !isa<klee::ConstantExpr>(condition))
+    summaries->abort(current);
+
   Solver::Validity res;
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&current);
@@ -745,8 +801,17 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     return StatePair(0, 0);
   }
 
+  unsigned choice;
   if (!isSeeding) {
-    if (replayPath && !isInternal) {
+    if (res==Solver::Unknown && replayDecision(current, 2, choice)) {
+      if (choice) {
+        res = Solver::True;
+        addConstraint(current, condition);
+      } else {
+        res = Solver::False;
+        addConstraint(current, Expr::createIsZero(condition));
+      }
+    } else if (replayPath && !isInternal) {
       assert(replayPosition<replayPath->size() &&
              "ran out of branches in replay path mode");
       bool branch = (*replayPath)[replayPosition++];
@@ -790,6 +855,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
           addConstraint(current, Expr::createIsZero(condition));
           res = Solver::False;
         }
+        recordDecision(current, res == Solver::True);
       }
     }
   }
@@ -801,14 +867,10 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       res == Solver::Unknown) {
     bool trueSeed=false, falseSeed=false;
     // Is seed extension still ok here?
+    SeedValueCache cache;
     for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
            siie = it->second.end(); siit != siie; ++siit) {
-      ref<ConstantExpr> res;
-      bool success = 
-        solver->getValue(current, siit->assignment.evaluate(condition), res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      if (res->isTrue()) {
+      if (getSeedValue(current, *siit, condition, cache)->isTrue()) {
         trueSeed = true;
       } else {
         falseSeed = true;
@@ -861,18 +923,14 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       std::swap(trueState, falseState);
 
     if (it != seedMap.end()) {
-      std::vector<SeedInfo> seeds = it->second;
-      it->second.clear();
+      std::vector<SeedInfo> seeds;
+      seeds.swap(it->second);
       std::vector<SeedInfo> &trueSeeds = seedMap[trueState];
       std::vector<SeedInfo> &falseSeeds = seedMap[falseState];
+      SeedValueCache cache;
       for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
              siie = seeds.end(); siit != siie; ++siit) {
-        ref<ConstantExpr> res;
-        bool success = 
-          solver->getValue(current, siit->assignment.evaluate(condition), res);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (res->isTrue()) {
+        if (getSeedValue(current, *siit, condition, cache)->isTrue()) {
           trueSeeds.push_back(*siit);
         } else {
           falseSeeds.push_back(*siit);
@@ -900,6 +958,9 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     falseState->ptreeNode = res.first;
     trueState->ptreeNode = res.second;
 
+    recordDecision(*trueState, 1);
+    recordDecision(*falseState, 0);
+
     if (!isInternal) {
       if (pathWriter) {
         falseState->pathOS = pathWriter->open(current.pathOS);
@@ -938,21 +999,34 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&state);
   if (it != seedMap.end()) {
-    bool warn = false;
+    // Seeds which agree on the condition share the query, and the seeds
+    // violating it are patched together.
+    std::map<ref<Expr>, bool> violates;
+    std::vector<SeedInfo*> violating;
     for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
            siie = it->second.end(); siit != siie; ++siit) {
+      ref<Expr> value = siit->assignment.evaluate(condition);
       bool res;
-      bool success = 
-        solver->mustBeFalse(state, siit->assignment.evaluate(condition), res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      if (res) {
-        siit->patchSeed(state, condition, solver);
-        warn = true;
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
+        res = CE->isFalse();
+      } else {
+        std::map<ref<Expr>, bool>::iterator vit = violates.find(value);
+        if (vit == violates.end()) {
+          bool success = solver->mustBeFalse(state, value, res);
+          assert(success && "FIXME: Unhandled solver failure");
+          (void) success;
+          violates.insert(std::make_pair(value, res));
+        } else {
+          res = vit->second;
+        }
       }
+      if (res)
+        violating.push_back(&*siit);
     }
-    if (warn)
+    if (!violating.empty()) {
+      SeedInfo::patchSeeds(state, condition, violating, solver);
       klee_warning("seeds patched for violating constraint"); 
+    }
   }
 
   state.addConstraint(condition);
@@ -1037,7 +1111,7 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
   } else {
     unsigned index = vnumber;
     StackFrame &sf = state.stack.back();
-    return sf.locals[index];
+    return (*sf.locals)[index];
   }
 }
 
@@ -1116,15 +1190,10 @@ void Executor::executeGetValue(ExecutionState &state,
     bindLocal(target, state, value);
   } else {
     std::set< ref<Expr> > values;
+    SeedValueCache cache;
     for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
-      ref<ConstantExpr> value;
-      bool success = 
-        solver->getValue(state, siit->assignment.evaluate(e), value);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      values.insert(value);
-    }
+           siie = it->second.end(); siit != siie; ++siit)
+      values.insert(getSeedValue(state, *siit, e, cache));
     
     std::vector< ref<Expr> > conditions;
     for (std::set< ref<Expr> >::iterator vit = values.begin(), 
@@ -1145,6 +1214,22 @@ void Executor::executeGetValue(ExecutionState &state,
   }
 }
 
+ref<klee::ConstantExpr> Executor::getSeedValue(ExecutionState &state,
+                                              SeedInfo &seed, ref<Expr> e,
+                                              SeedValueCache &cache) {
+  ref<Expr> value = seed.assignment.evaluate(e);
+  if (klee::ConstantExpr *CE = dyn_cast<klee::ConstantExpr>(value))
+    return CE;
+
+  ref<klee::ConstantExpr> &result = cache[value];
+  if (result.isNull()) {
+    bool success = solver->getValue(state, value, result);
+    assert(success && "FIXME: Unhandled solver failure");
+    (void) success;
+  }
+  return result;
+}
+
 void Executor::stepInstruction(ExecutionState &state) {
   if (DebugPrintInstructions) {
     printFileLine(state, state.pc);
@@ -1230,13 +1315,34 @@ void Executor::executeCall(ExecutionState &state,
     if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
       transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
   } else {
+    if (specialFunctionHandler->handleBuiltin(state, f, ki, arguments) ||
+        (FastForwardConcreteCalls && callNative(state, ki, f, arguments))) {
+      if (summaries)
+        summaries->abort(state);
+      return;
+    }
+
+    KFunction *kf = getKFunction(f);
+    bool summarize = summaries && isa<CallInst>(i) &&
+      i->getType() == f->getReturnType();
+    if (summarize) {
+      ref<Expr> result;
+      if (summaries->lookup(state, kf, arguments, result)) {
+        if (!result.isNull())
+          bindLocal(ki, state, result);
+        return;
+      }
+    }
+
     // FIXME: I'm not really happy about this reliance on prevPC but it is ok, I
     // guess. This just done to avoid having to pass KInstIterator everywhere
     // instead of the actual instruction, since we can't make a KInstIterator
     // from just an instruction (unlike LLVM).
-    KFunction *kf = kmodule->functionMap[f];
     state.pushFrame(state.prevPC, kf);
     state.pc = kf->instructions;
+
+    if (summarize)
+      summaries->callEntered(state, kf, arguments);
         
     if (statsTracker)
       statsTracker->framePushed(state, &state.stack[state.stack.size()-2]);
@@ -1347,6 +1453,14 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
   }
 }
 
+void Executor::transferToEntry(unsigned entry, int incomingBBIndex,
+                               ExecutionState &state) {
+  KFunction *kf = state.stack.back().kf;
+  state.pc = &kf->instructions[entry];
+  if (incomingBBIndex >= 0)
+    state.incomingBBIndex = incomingBBIndex;
+}
+
 void Executor::printFileLine(ExecutionState &state, KInstruction *ki) {
   const InstructionInfo &ii = *ki->info;
   if (ii.file != "")
@@ -1416,6 +1530,19 @@ static inline const llvm::fltSemantics * fpWidthToSemantics(unsigned width) {
 }
 
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
+  // Instructions whose result only depends on their operands were decoded
+  // by KModule and need not look at the LLVM instruction.
+  if (ki->binaryOp) {
+    ref<Expr> left = eval(ki, 0, state).value;
+    ref<Expr> right = eval(ki, 1, state).value;
+    bindLocal(ki, state, ki->binaryOp(left, right));
+    return;
+  }
+  if (ki->castOp) {
+    bindLocal(ki, state, ki->castOp(eval(ki, 0, state).value, ki->width));
+    return;
+  }
+
   Instruction *i = ki->inst;
   switch (i->getOpcode()) {
     // Control flow
@@ -1439,6 +1566,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       if (statsTracker)
         statsTracker->framePopped(state);
 
+      if (summaries)
+        summaries->callReturned(state, isVoidReturn ? ref<Expr>() : result);
+
       if (InvokeInst *ii = dyn_cast<InvokeInst>(caller)) {
         transferToBasicBlock(ii->getNormalDest(), caller->getParent(), state);
       } else {
@@ -1510,8 +1640,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 #endif
   case Instruction::Br: {
     BranchInst *bi = cast<BranchInst>(i);
+    KBranchInstruction *kbi = static_cast<KBranchInstruction*>(ki);
     if (bi->isUnconditional()) {
-      transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), state);
+      transferToEntry(kbi->targets[0], kbi->incoming[0], state);
     } else {
       // FIXME: Find a way that we don't have this hidden dependency.
       assert(bi->getCondition() == bi->getOperand(0) &&
@@ -1527,9 +1658,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         statsTracker->markBranchVisited(branches.first, branches.second);
 
       if (branches.first)
-        transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), *branches.first);
+        transferToEntry(kbi->targets[0], kbi->incoming[0], *branches.first);
       if (branches.second)
-        transferToBasicBlock(bi->getSuccessor(1), bi->getParent(), *branches.second);
+        transferToEntry(kbi->targets[1], kbi->incoming[1], *branches.second);
     }
     break;
   }
@@ -1552,40 +1683,43 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 #endif
       transferToBasicBlock(si->getSuccessor(index), si->getParent(), state);
     } else {
-      std::map<BasicBlock*, ref<Expr> > targets;
+      // Collect the condition for every case and for the default, and ask
+      // the solver about all of them at once.
+      std::vector< ref<Expr> > matches;
+      std::vector<BasicBlock*> successors;
       ref<Expr> isDefault = ConstantExpr::alloc(1, Expr::Bool);
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)      
       for (SwitchInst::CaseIt i = si->case_begin(), e = si->case_end();
            i != e; ++i) {
         ref<Expr> value = evalConstant(i.getCaseValue());
+        successors.push_back(i.getCaseSuccessor());
 #else
       for (unsigned i=1, cases = si->getNumCases(); i<cases; ++i) {
         ref<Expr> value = evalConstant(si->getCaseValue(i));
+        successors.push_back(si->getSuccessor(i));
 #endif
         ref<Expr> match = EqExpr::create(cond, value);
         isDefault = AndExpr::create(isDefault, Expr::createIsZero(match));
-        bool result;
-        bool success = solver->mayBeTrue(state, match, result);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (result) {
-#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)
-          BasicBlock *caseSuccessor = i.getCaseSuccessor();
-#else
-          BasicBlock *caseSuccessor = si->getSuccessor(i);
-#endif
+        matches.push_back(match);
+      }
+      matches.push_back(isDefault);
+
+      std::vector<bool> results;
+      bool success = solver->mayBeTrue(state, matches, results);
+      assert(success && "FIXME: Unhandled solver failure");
+      (void) success;
+
+      std::map<BasicBlock*, ref<Expr> > targets;
+      for (unsigned i = 0, e = successors.size(); i != e; ++i) {
+        if (results[i]) {
           std::map<BasicBlock*, ref<Expr> >::iterator it =
-            targets.insert(std::make_pair(caseSuccessor,
+            targets.insert(std::make_pair(successors[i],
                            ConstantExpr::alloc(0, Expr::Bool))).first;
 
-          it->second = OrExpr::create(match, it->second);
+          it->second = OrExpr::create(matches[i], it->second);
         }
       }
-      bool res;
-      bool success = solver->mayBeTrue(state, isDefault, res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      if (res)
+      if (results.back())
         targets.insert(std::make_pair(si->getDefaultDest(), isDefault));
       
       std::vector< ref<Expr> > conditions;
@@ -1749,202 +1883,13 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     terminateStateOnExecError(state, "unexpected VAArg instruction");
     break;
 
-    // Arithmetic / logical
-
-  case Instruction::Add: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, AddExpr::create(left, right));
-    break;
-  }
-
-  case Instruction::Sub: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, SubExpr::create(left, right));
-    break;
-  }
- 
-  case Instruction::Mul: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, MulExpr::create(left, right));
-    break;
-  }
-
-  case Instruction::UDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = UDivExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
-
-  case Instruction::SDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = SDivExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
-
-  case Instruction::URem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = URemExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
- 
-  case Instruction::SRem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = SRemExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
-
-  case Instruction::And: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = AndExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
-
-  case Instruction::Or: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = OrExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
-
-  case Instruction::Xor: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = XorExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
-
-  case Instruction::Shl: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = ShlExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
-
-  case Instruction::LShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = LShrExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
+    // Arithmetic, logical and integer comparison instructions are
+    // executed through KInstruction::binaryOp.
 
-  case Instruction::AShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = AShrExpr::create(left, right);
-    bindLocal(ki, state, result);
+  case Instruction::ICmp:
+    terminateStateOnExecError(state, "invalid ICmp predicate");
     break;
-  }
-
-    // Compare
-
-  case Instruction::ICmp: {
-    CmpInst *ci = cast<CmpInst>(i);
-    ICmpInst *ii = cast<ICmpInst>(ci);
- 
-    switch(ii->getPredicate()) {
-    case ICmpInst::ICMP_EQ: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = EqExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
-
-    case ICmpInst::ICMP_NE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = NeExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
-
-    case ICmpInst::ICMP_UGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UgtExpr::create(left, right);
-      bindLocal(ki, state,result);
-      break;
-    }
 
-    case ICmpInst::ICMP_UGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UgeExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
-
-    case ICmpInst::ICMP_ULT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UltExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
-
-    case ICmpInst::ICMP_ULE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UleExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
-
-    case ICmpInst::ICMP_SGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SgtExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
-
-    case ICmpInst::ICMP_SGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SgeExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
-
-    case ICmpInst::ICMP_SLT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SltExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
-
-    case ICmpInst::ICMP_SLE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SleExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
-
-    default:
-      terminateStateOnExecError(state, "invalid ICmp predicate");
-    }
-    break;
-  }
- 
     // Memory instructions...
   case Instruction::Alloca: {
     AllocaInst *ai = cast<AllocaInst>(i);
@@ -1993,45 +1938,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     break;
   }
 
-    // Conversion
-  case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value,
-                                           0,
-                                           getWidthForLLVMType(ci->getType()));
-    bindLocal(ki, state, result);
-    break;
-  }
-  case Instruction::ZExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
-    bindLocal(ki, state, result);
-    break;
-  }
-  case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
-    bindLocal(ki, state, result);
-    break;
-  }
-
-  case Instruction::IntToPtr: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width pType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
-    bindLocal(ki, state, ZExtExpr::create(arg, pType));
-    break;
-  } 
-  case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width iType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
-    bindLocal(ki, state, ZExtExpr::create(arg, iType));
-    break;
-  }
-
+    // Conversion (integer casts are executed through KInstruction::castOp)
   case Instruction::BitCast: {
     ref<Expr> result = eval(ki, 0, state).value;
     bindLocal(ki, state, result);
@@ -2407,6 +2314,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 void Executor::updateStates(ExecutionState *current) {
   if (searcher) {
     searcher->update(current, addedStates, removedStates);
+    if (searcherTrace)
+      searcherTrace->update(current, addedStates, removedStates);
   }
   
   states.insert(addedStates.begin(), addedStates.end());
@@ -2423,6 +2332,9 @@ void Executor::updateStates(ExecutionState *current) {
       seedMap.find(es);
     if (it3 != seedMap.end())
       seedMap.erase(it3);
+    // Covers terminated as well as retired states.
+    if (summaries)
+      summaries->abort(*es);
     processTree->remove(es->ptreeNode);
     delete es;
   }
@@ -2477,20 +2389,37 @@ void Executor::bindInstructionConstants(KInstruction *KI) {
 }
 
 void Executor::bindModuleConstants() {
-  for (std::vector<KFunction*>::iterator it = kmodule->functions.begin(), 
-         ie = kmodule->functions.end(); it != ie; ++it) {
-    KFunction *kf = *it;
-    for (unsigned i=0; i<kf->numInstructions; ++i)
-      bindInstructionConstants(kf->instructions[i]);
-  }
+  // Global addresses change between runs, so everything is evaluated
+  // again.
+  kmodule->constantTable.clear();
+  bindNewConstants();
+  constantsBound = true;
+}
 
-  kmodule->constantTable = new Cell[kmodule->constants.size()];
-  for (unsigned i=0; i<kmodule->constants.size(); ++i) {
-    Cell &c = kmodule->constantTable[i];
-    c.value = evalConstant(kmodule->constants[i]);
+void Executor::bindNewConstants() {
+  for (unsigned i = kmodule->constantTable.size(),
+         e = kmodule->constants.size(); i != e; ++i) {
+    kmodule->constantTable.push_back(Cell());
+    kmodule->constantTable.back().value = evalConstant(kmodule->constants[i]);
   }
 }
 
+KFunction *Executor::getKFunction(Function *f) {
+  std::map<Function*, KFunction*>::iterator it =
+    kmodule->functionMap.find(f);
+  if (it != kmodule->functionMap.end())
+    return it->second;
+
+  KFunction *kf = kmodule->buildKFunction(f);
+  for (unsigned i=0; i<kf->numInstructions; ++i)
+    bindInstructionConstants(kf->instructions[i]);
+  // Before the first run the globals have no address yet, the constants
+  // are then evaluated by bindModuleConstants.
+  if (constantsBound)
+    bindNewConstants();
+  return kf;
+}
+
 void Executor::run(ExecutionState &initialState) {
   bindModuleConstants();
 
@@ -2500,6 +2429,9 @@ void Executor::run(ExecutionState &initialState) {
 
   states.insert(&initialState);
 
+  if (MaxResidentStates)
+    pristineState = new ExecutionState(initialState);
+
   if (usingSeeds) {
     std::vector<SeedInfo> &v = seedMap[&initialState];
     
@@ -2520,12 +2452,22 @@ void Executor::run(ExecutionState &initialState) {
       lastState = it->first;
       unsigned numSeeds = it->second.size();
       ExecutionState &state = *lastState;
-      KInstruction *ki = state.pc;
-      stepInstruction(state);
 
-      executeInstruction(state, ki);
-      processTimers(&state, MaxInstructionTime * numSeeds);
-      updateStates(&state);
+      // Run the state on its own until it forks or terminates, or its
+      // quantum runs out, rather than switching states every instruction.
+      for (unsigned steps = 0;;) {
+        KInstruction *ki = state.pc;
+        stepInstruction(state);
+
+        executeInstruction(state, ki);
+        processTimers(&state, MaxInstructionTime * numSeeds);
+        bool changed = !addedStates.empty() || !removedStates.empty();
+        updateStates(&state);
+
+        if (changed || haltExecution || ++steps >= SeedStepInstructions ||
+            (stats::instructions % 1000) == 0 || !seedMap.count(&state))
+          break;
+      }
 
       if ((stats::instructions % 1000) == 0) {
         int numSeeds = 0, numStates = 0;
@@ -2568,8 +2510,22 @@ void Executor::run(ExecutionState &initialState) {
 
   searcher->update(0, states, std::set<ExecutionState*>());
 
+  if (WriteSearcherTrace) {
+    if (llvm::raw_ostream *os =
+          interpreterHandler->openOutputFile("searcher.trace")) {
+      searcherTrace = new SearcherTraceWriter(os);
+      searcherTrace->update(0, states, std::set<ExecutionState*>());
+    }
+  }
+
+  if (SwapStates && MaxMemory)
+    stateSwapper =
+      new StateSwapper(interpreterHandler->getOutputFilename("states.swap"));
+
   while (!states.empty() && !haltExecution) {
     ExecutionState &state = searcher->selectState();
+    if (state.suspended)
+      stateSwapper->resume(state);
     KInstruction *ki = state.pc;
     stepInstruction(state);
 
@@ -2583,7 +2539,9 @@ void Executor::run(ExecutionState &initialState) {
         // to pummel the freelist once we hit the memory cap.
         unsigned mbs = util::GetTotalMallocUsage() >> 20;
         if (mbs > MaxMemory) {
-          if (mbs > MaxMemory + 100) {
+          if (stateSwapper) {
+            suspendStates(state, mbs);
+          } else if (mbs > MaxMemory + 100) {
             // just guess at how many to kill
             unsigned numStates = states.size();
             unsigned toKill = std::max(1U, numStates - numStates*MaxMemory/mbs);
@@ -2611,10 +2569,24 @@ void Executor::run(ExecutionState &initialState) {
     }
 
     updateStates(&state);
+
+    if (MaxResidentStates)
+      balanceResidentStates();
   }
 
   delete searcher;
   searcher = 0;
+  delete searcherTrace;
+  searcherTrace = 0;
+
+  if (pristineState) {
+    if (!retiredStates.empty())
+      klee_warning("%d retired states were not recreated",
+                   (int) retiredStates.size());
+    retiredStates.clear();
+    delete pristineState;
+    pristineState = 0;
+  }
   
  dump:
   if (DumpStatesOnHalt && !states.empty()) {
@@ -2688,6 +2660,10 @@ void Executor::terminateState(ExecutionState &state) {
 
   interpreterHandler->incPathsExplored();
 
+  if (state.suspended)
+    stateSwapper->discard(state);
+  replayingStates.erase(&state);
+
   std::set<ExecutionState*>::iterator it = addedStates.find(&state);
   if (it==addedStates.end()) {
     state.pc = state.prevPC;
@@ -2699,14 +2675,165 @@ void Executor::terminateState(ExecutionState &state) {
       seedMap.find(&state);
     if (it3 != seedMap.end())
       seedMap.erase(it3);
+    if (summaries)
+      summaries->abort(state);
     addedStates.erase(it);
     processTree->remove(state.ptreeNode);
     delete &state;
   }
 }
 
+void Executor::suspendStates(ExecutionState &current, unsigned mbs) {
+  unsigned numStates = states.size();
+  unsigned toSuspend = numStates - numStates*MaxMemory/mbs;
+
+  // The states which went the longest without covering new code are the
+  // least likely to be selected soon.
+  std::vector<std::pair<unsigned, ExecutionState*> > candidates;
+  for (std::set<ExecutionState*>::iterator it = states.begin(),
+         ie = states.end(); it != ie; ++it) {
+    ExecutionState *es = *it;
+    if (es != &current && !es->suspended && !addedStates.count(es) &&
+        !removedStates.count(es))
+      candidates.push_back(std::make_pair(es->instsSinceCovNew, es));
+  }
+  toSuspend = std::min(toSuspend, (unsigned) candidates.size());
+  if (!toSuspend)
+    return;
+
+  std::partial_sort(candidates.begin(), candidates.begin() + toSuspend,
+                    candidates.end(),
+                    std::greater<std::pair<unsigned, ExecutionState*> >());
+
+  klee_warning("suspending %d states (over memory cap)", toSuspend);
+  for (unsigned i = 0; i != toSuspend; ++i)
+    stateSwapper->suspend(*candidates[i].second);
+}
+
+void Executor::retireState(ExecutionState &state) {
+  assert(!addedStates.count(&state) && !replayingStates.count(&state) &&
+         !state.merged);
+
+  retiredStates.push_back(std::vector<unsigned char>());
+  retiredStates.back().swap(state.decisions);
+
+  if (state.suspended)
+    stateSwapper->discard(state);
+
+  state.pc = state.prevPC;
+  removedStates.insert(&state);
+}
+
+void Executor::balanceResidentStates() {
+  if (states.size() > MaxResidentStates) {
+    // Retire the states which went the longest without covering new code;
+    // states still replaying would only have to start over, and replaying
+    // a merged state would only recreate one of its paths.
+    std::vector<std::pair<unsigned, ExecutionState*> > candidates;
+    for (std::set<ExecutionState*>::iterator it = states.begin(),
+           ie = states.end(); it != ie; ++it) {
+      ExecutionState *es = *it;
+      if (!replayingStates.count(es) && !seedMap.count(es) && !es->merged)
+        candidates.push_back(std::make_pair(es->instsSinceCovNew, es));
+    }
+    unsigned toRetire = std::min(states.size() - MaxResidentStates,
+                                 candidates.size());
+    if (!toRetire)
+      return;
+
+    std::partial_sort(candidates.begin(), candidates.begin() + toRetire,
+                      candidates.end(),
+                      std::greater<std::pair<unsigned, ExecutionState*> >());
+    for (unsigned i = 0; i != toRetire; ++i)
+      retireState(*candidates[i].second);
+  } else {
+    if (retiredStates.empty() || states.size() == MaxResidentStates)
+      return;
+
+    // Recreate the most recently retired state from the initial one; it
+    // follows its recorded decisions until they run out.
+    ExecutionState *es = new ExecutionState(*pristineState);
+    es->decisions.swap(retiredStates.back());
+    retiredStates.pop_back();
+    if (!es->decisions.empty())
+      replayingStates[es] = 0;
+    if (pathWriter)
+      es->pathOS = pathWriter->open();
+    if (symPathWriter)
+      es->symPathOS = symPathWriter->open();
+    es->ptreeNode = processTree->insert(es);
+    addedStates.insert(es);
+  }
+
+  updateStates(0);
+}
+
+/// Append \arg value to \arg out in a variable length encoding, seven bits
+/// per byte.
+static void writeVarint(std::vector<unsigned char> &out, unsigned value) {
+  do {
+    unsigned char byte = value & 0x7F;
+    value >>= 7;
+    out.push_back(value ? byte | 0x80 : byte);
+  } while (value);
+}
+
+/// Decode the value written by writeVarint at \arg pos, advancing it.
+static unsigned readVarint(const std::vector<unsigned char> &in,
+                           size_t &pos) {
+  unsigned value = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    unsigned char byte = in[pos++];
+    value |= (unsigned) (byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return value;
+  }
+}
+
+void Executor::recordDecision(ExecutionState &state, unsigned choice) {
+  if (!MaxResidentStates)
+    return;
+
+  // The branching instruction is kept to detect a replay going astray;
+  // most decisions are binary and take a byte.
+  writeVarint(state.decisions, state.prevPC->info->id);
+  writeVarint(state.decisions, choice);
+}
+
+bool Executor::replayDecision(ExecutionState &state, unsigned numChoices,
+                              unsigned &choice) {
+  if (replayingStates.empty())
+    return false;
+  std::map<ExecutionState*, size_t>::iterator it =
+    replayingStates.find(&state);
+  if (it == replayingStates.end())
+    return false;
+
+  size_t start = it->second;
+  unsigned id = readVarint(state.decisions, it->second);
+  choice = readVarint(state.decisions, it->second);
+  if (id != state.prevPC->info->id || choice >= numChoices) {
+    // Objects get different addresses in the recreated state, so branches
+    // depending on them can go differently. Explore on from here, keeping
+    // only the decisions which did replay.
+    klee_warning_once(0, "recreated state diverged from its recorded path, "
+                      "exploring it normally");
+    state.decisions.resize(start);
+    replayingStates.erase(it);
+    return false;
+  }
+  if (it->second == state.decisions.size())
+    replayingStates.erase(it);
+
+  // Account for the branch as if the state had forked here.
+  ++state.depth;
+  return true;
+}
+
 void Executor::terminateStateEarly(ExecutionState &state, 
                                    const Twine &message) {
+  if (state.suspended)
+    stateSwapper->resume(state);
   if (!OnlyOutputStatesCoveringNew || state.coveredNew ||
       (AlwaysOutputSeeds && seedMap.count(&state)))
     interpreterHandler->processTestCase(state, (message + "\n").str().c_str(),
@@ -2715,6 +2842,8 @@ void Executor::terminateStateEarly(ExecutionState &state,
 }
 
 void Executor::terminateStateOnExit(ExecutionState &state) {
+  if (state.suspended)
+    stateSwapper->resume(state);
   if (!OnlyOutputStatesCoveringNew || state.coveredNew || 
       (AlwaysOutputSeeds && seedMap.count(&state)))
     interpreterHandler->processTestCase(state, 0, 0);
@@ -2816,8 +2945,13 @@ void Executor::callExternalFunction(ExecutionState &state,
                                     KInstruction *target,
                                     Function *function,
                                     std::vector< ref<Expr> > &arguments) {
+  if (summaries)
+    summaries->abort(state);
+
   // check if specialFunctionHandler wants it
-  if (specialFunctionHandler->handle(state, function, target, arguments))
+  if (specialFunctionHandler->handle(state, function, target, arguments) ||
+      specialFunctionHandler->handleBuiltin(state, function, target,
+                                            arguments))
     return;
   
   if (NoExternals && !okExternals.count(function->getName())) {
@@ -2899,6 +3033,133 @@ void Executor::callExternalFunction(ExecutionState &state,
   }
 }
 
+bool Executor::isNativeCallable(Function *f) {
+  std::map<const Function*, bool>::iterator it = nativeCallable.find(f);
+  if (it != nativeCallable.end())
+    return it->second;
+
+  bool &result = nativeCallable[f];
+  result = false;
+
+  std::set<Function*> visited;
+  std::vector<Function*> worklist(1, f);
+  visited.insert(f);
+  while (!worklist.empty()) {
+    Function *g = worklist.back();
+    worklist.pop_back();
+
+    if (g->isDeclaration()) {
+      switch (g->getIntrinsicID()) {
+      case Intrinsic::not_intrinsic:
+      case Intrinsic::vastart:
+      case Intrinsic::vaend:
+      case Intrinsic::vacopy:
+        return false;
+      default:
+        continue;
+      }
+    }
+
+    for (inst_iterator ii = inst_begin(g), ie = inst_end(g); ii != ie; ++ii) {
+      Instruction *i = &*ii;
+      std::vector<Value*> operands;
+
+      if (CallInst *ci = dyn_cast<CallInst>(i)) {
+        Function *callee =
+          dyn_cast<Function>(ci->getCalledValue()->stripPointerCasts());
+        if (!callee)
+          return false;
+        if (visited.insert(callee).second)
+          worklist.push_back(callee);
+        for (unsigned j = 0, je = ci->getNumArgOperands(); j != je; ++j)
+          operands.push_back(ci->getArgOperand(j));
+      } else if (isa<InvokeInst>(i) || isa<LandingPadInst>(i) ||
+                 isa<ResumeInst>(i)) {
+        return false;
+      } else {
+        operands.assign(i->op_begin(), i->op_end());
+      }
+
+      // Function addresses are not the native ones, and aliases are not
+      // copied.
+      while (!operands.empty()) {
+        Value *v = operands.back();
+        operands.pop_back();
+        if (isa<Function>(v) || isa<GlobalAlias>(v))
+          return false;
+        if (llvm::ConstantExpr *ce = dyn_cast<llvm::ConstantExpr>(v))
+          operands.insert(operands.end(), ce->op_begin(), ce->op_end());
+      }
+    }
+  }
+
+  return result = true;
+}
+
+bool Executor::callNative(ExecutionState &state, KInstruction *target,
+                          Function *function,
+                          std::vector< ref<Expr> > &arguments) {
+  if (!isa<CallInst>(target->inst) || function->isVarArg() ||
+      arguments.size() != function->arg_size() ||
+      !isNativeCallable(function))
+    return false;
+
+  // The native code may reach any object through pointers, so all of them
+  // must be concrete. Symbolic bytes only come from the state's symbolic
+  // objects, or from concrete values made symbolic, so once either exists
+  // the check below would almost always fail and is skipped.
+  if (!state.symbolics->empty() || interpreterOpts.MakeConcreteSymbolic)
+    return false;
+  for (std::vector< ref<Expr> >::iterator ai = arguments.begin(),
+         ae = arguments.end(); ai != ae; ++ai)
+    if (!isa<klee::ConstantExpr>(*ai))
+      return false;
+  for (MemoryMap::iterator it = state.addressSpace.objects.begin(),
+         ie = state.addressSpace.objects.end(); it != ie; ++it) {
+    const ObjectState *os = it->second;
+    if (!os->isConcrete())
+      return false;
+  }
+
+  // Same layout as in callExternalFunction.
+  uint64_t *args = (uint64_t*) alloca(2*sizeof(*args) * (arguments.size() + 1));
+  memset(args, 0, 2 * sizeof(*args) * (arguments.size() + 1));
+  unsigned wordIndex = 2;
+  for (std::vector< ref<Expr> >::iterator ai = arguments.begin(),
+         ae = arguments.end(); ai != ae; ++ai) {
+    klee::ConstantExpr *ce = cast<klee::ConstantExpr>(*ai);
+    ce->toMemory(&args[wordIndex]);
+    wordIndex += (ce->getWidth()+63)/64;
+  }
+
+  if (!SuppressExternalWarnings)
+    klee_warning_once(function, "calling %s natively",
+                      function->getName().data());
+
+  state.addressSpace.copyOutConcretes();
+  bool success = externalDispatcher->executeNativeCall(function, target->inst,
+                                                       args, globalObjects);
+  if (!success) {
+    terminateStateOnError(state, "failed native call: " + function->getName(),
+                          "external.err");
+    return true;
+  }
+
+  if (!state.addressSpace.copyInConcretes()) {
+    terminateStateOnError(state, "native call modified read-only object",
+                          "external.err");
+    return true;
+  }
+
+  LLVM_TYPE_Q Type *resultType = target->inst->getType();
+  if (resultType != Type::getVoidTy(getGlobalContext())) {
+    ref<Expr> e = klee::ConstantExpr::fromMemory((void*) args,
+                                                 getWidthForLLVMType(resultType));
+    bindLocal(target, state, e);
+  }
+  return true;
+}
+
 /***/
 
 ref<Expr> Executor::replaceReadWithSymbolic(ExecutionState &state, 
@@ -2950,6 +3211,10 @@ void Executor::executeAlloc(ExecutionState &state,
                             KInstruction *target,
                             bool zeroMemory,
                             const ObjectState *reallocFrom) {
+  // Heap objects outlive the call, which then cannot be summarized.
+  if (summaries && !isLocal)
+    summaries->abort(state);
+
   size = toUnique(state, size);
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(size)) {
     MemoryObject *mo = memory->allocate(CE->getZExtValue(), isLocal, false, 
@@ -3174,11 +3439,15 @@ void Executor::executeMemoryOperation(ExecutionState &state,
                                 "memory error: object read only",
                                 "readonly.err");
         } else {
+          if (summaries)
+            summaries->memoryWritten(state, mo);
           ObjectState *wos = state.addressSpace.getWriteable(mo, os);
           wos->write(offset, value);
         }          
       } else {
         ref<Expr> result = os->read(offset, type);
+        if (summaries)
+          summaries->memoryRead(state, mo, offset, result);
         
         if (interpreterOpts.MakeConcreteSymbolic)
           result = replaceReadWithSymbolic(state, result);
@@ -3192,6 +3461,8 @@ void Executor::executeMemoryOperation(ExecutionState &state,
 
   // we are on an error path (no resolution, multiple resolution, one
   // resolution with out of bounds)
+  if (summaries)
+    summaries->abort(state);
   
   ResolutionList rl;  
   solver->setTimeout(coreSolverTimeout);
@@ -3254,9 +3525,10 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
     // or if that fails try adding a unique identifier.
     unsigned id = 0;
     std::string uniqueName = name;
-    while (!state.arrayNames.insert(uniqueName).second) {
+    while (state.arrayNames->count(uniqueName)) {
       uniqueName = name + "_" + llvm::utostr(++id);
     }
+    state.arrayNames.getWritable().insert(uniqueName);
     const Array *array = Array::CreateArray(uniqueName, mo->size);
     bindObjectInState(state, mo, false, array);
     state.addSymbolic(mo, array);
@@ -3346,8 +3618,7 @@ void Executor::runFunctionAsMain(Function *f,
   for (envc=0; envp[envc]; ++envc) ;
 
   unsigned NumPtrBytes = Context::get().getPointerWidth() / 8;
-  KFunction *kf = kmodule->functionMap[f];
-  assert(kf);
+  KFunction *kf = getKFunction(f);
   Function::arg_iterator ai = f->arg_begin(), ae = f->arg_end();
   if (ai!=ae) {
     arguments.push_back(ConstantExpr::alloc(argc, Expr::Int32));
@@ -3368,7 +3639,7 @@ void Executor::runFunctionAsMain(Function *f,
     }
   }
 
-  ExecutionState *state = new ExecutionState(kmodule->functionMap[f]);
+  ExecutionState *state = new ExecutionState(kf);
   
   if (pathWriter) 
     state->pathOS = pathWriter->open();
@@ -3407,12 +3678,22 @@ void Executor::runFunctionAsMain(Function *f,
   
   initializeGlobals(*state);
 
+  if (SummarizeFunctions && !interpreterOpts.MakeConcreteSymbolic)
+    summaries = new FunctionSummaries();
+
   processTree = new PTree(state);
   state->ptreeNode = processTree->root;
   run(*state);
   delete processTree;
   processTree = 0;
 
+  if (summaries) {
+    klee_message("function summaries: %u recorded, %u reused",
+                 summaries->getNumRecorded(), summaries->getHits());
+    delete summaries;
+    summaries = 0;
+  }
+
   // hack to clear memory objects
   delete memory;
   memory = new MemoryManager();
@@ -3486,8 +3767,8 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
   // the preferred constraints.  See test/Features/PreferCex.c for
   // an example) While this process can be very expensive, it can
   // also make understanding individual test cases much easier.
-  for (unsigned i = 0; i != state.symbolics.size(); ++i) {
-    const MemoryObject *mo = state.symbolics[i].first;
+  for (unsigned i = 0; i != state.symbolics->size(); ++i) {
+    const MemoryObject *mo = (*state.symbolics)[i].first;
     std::vector< ref<Expr> >::const_iterator pi = 
       mo->cexPreferences.begin(), pie = mo->cexPreferences.end();
     for (; pi != pie; ++pi) {
@@ -3509,8 +3790,8 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
 
   std::vector< std::vector<unsigned char> > values;
   std::vector<const Array*> objects;
-  for (unsigned i = 0; i != state.symbolics.size(); ++i)
-    objects.push_back(state.symbolics[i].second);
+  for (unsigned i = 0; i != state.symbolics->size(); ++i)
+    objects.push_back((*state.symbolics)[i].second);
   bool success = solver->getInitialValues(tmp, objects, values);
   solver->setTimeout(0);
   if (!success) {
@@ -3520,14 +3801,18 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
     return false;
   }
   
-  for (unsigned i = 0; i != state.symbolics.size(); ++i)
-    res.push_back(std::make_pair(state.symbolics[i].first->name, values[i]));
+  for (unsigned i = 0; i != state.symbolics->size(); ++i)
+    res.push_back(std::make_pair((*state.symbolics)[i].first->name, values[i]));
   return true;
 }
 
 void Executor::getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) {
-  res = state.coveredLines;
+  res.clear();
+  for (ExecutionState::covered_lines_ty::iterator
+         it = state.coveredLines.begin(), ie = state.coveredLines.end();
+       it != ie; ++it)
+    res[it->first].insert(it->second);
 }
 
 void Executor::doImpliedValueConcretization(ExecutionState &state,
@@ -63,10 +63,13 @@ namespace klee {
   class MemoryObject;
   class ObjectState;
   class PTree;
+  class FunctionSummaries;
   class Searcher;
+  class SearcherTraceWriter;
   class SeedInfo;
   class SpecialFunctionHandler;
   struct StackFrame;
+  class StateSwapper;
   class StatsTracker;
   class TimingSolver;
   class TreeStreamWriter;
@@ -80,10 +83,14 @@ namespace klee {
 
 class Executor : public Interpreter {
   friend class BumpMergingSearcher;
+  friend class DynamicMergingSearcher;
   friend class MergingSearcher;
   friend class RandomPathSearcher;
+  friend class RegionMergingSearcher;
   friend class OwningSearcher;
   friend class WeightedRandomSearcher;
+  friend class WeightedRandomPathSearcher;
+  friend class SearcherBenchmark;
   friend class SpecialFunctionHandler;
   friend class StatsTracker;
 
@@ -116,6 +123,30 @@ private:
   std::vector<TimerInfo*> timers;
   PTree *processTree;
 
+  /// When non-null, states are suspended to disk instead of being
+  /// terminated when over the memory cap.
+  StateSwapper *stateSwapper;
+
+  /// When non-null, the updates of the searcher are recorded.
+  SearcherTraceWriter *searcherTrace;
+
+  /// When non-null, calls with concrete inputs are summarized and reused.
+  FunctionSummaries *summaries;
+
+  /// Whether the constant table has been bound, after which functions
+  /// built on first call extend it at once.
+  bool constantsBound;
+
+  /// A copy of the initial state, from which retired states are recreated
+  /// by replaying their branch decisions. \see --max-resident-states
+  ExecutionState *pristineState;
+  /// The branch decisions of the states retired to keep the number of
+  /// resident states under the limit, most recently retired last.
+  std::vector<std::vector<unsigned char> > retiredStates;
+  /// The position of each replaying state in its \ref
+  /// ExecutionState::decisions.
+  std::map<ExecutionState*, size_t> replayingStates;
+
   /// Used to track states that have been added during the current
   /// instructions step. 
   /// \invariant \ref addedStates is a subset of \ref states. 
@@ -147,6 +178,10 @@ private:
   /// pointers. We use the actual Function* address as the function address.
   std::set<uint64_t> legalFunctions;
 
+  /// Whether each function checked so far can be executed natively, see
+  /// isNativeCallable.
+  std::map<const llvm::Function*, bool> nativeCallable;
+
   /// When non-null the bindings that will be used for calls to
   /// klee_make_symbolic in order replay.
   const struct KTest *replayOut;
@@ -164,6 +199,24 @@ private:
   /// needed to control memory usage. \see fork()
   bool atMemoryLimit;
 
+  /// Suspend the coldest states until the memory usage of \arg mbs
+  /// megabytes is expected to be under the cap. \arg current is kept.
+  void suspendStates(ExecutionState &current, unsigned mbs);
+
+  /// Retire the coldest states when there are more than
+  /// --max-resident-states of them, and recreate retired states when there
+  /// is room.
+  void balanceResidentStates();
+
+  /// Record \arg choice as the next decision of \arg state.
+  void recordDecision(ExecutionState &state, unsigned choice);
+
+  /// If \arg state is replaying its decisions, consume the next one into
+  /// \arg choice and return true. A decision made at another instruction,
+  /// or out of the \arg numChoices, ends the replay and returns false.
+  bool replayDecision(ExecutionState &state, unsigned numChoices,
+                      unsigned &choice);
+
   /// Disables forking, set by client. \see setInhibitForking()
   bool inhibitForking;
 
@@ -204,11 +257,32 @@ private:
 			    llvm::BasicBlock *src,
 			    ExecutionState &state);
 
+  /// Continue \arg state at the instruction with index \arg entry of the
+  /// current function, as pre-resolved by KModule for branch targets.
+  /// \arg incomingBBIndex is the PHI incoming index of the predecessor, or
+  /// -1 if the target does not start with a PHI node.
+  void transferToEntry(unsigned entry, int incomingBBIndex,
+                       ExecutionState &state);
+
   void callExternalFunction(ExecutionState &state,
                             KInstruction *target,
                             llvm::Function *function,
                             std::vector< ref<Expr> > &arguments);
 
+  /// Return true if \arg f and every function it may call can be run
+  /// natively: all calls are direct calls to functions defined in the
+  /// module or to intrinsics, no function address is taken, and no
+  /// exceptions are used.
+  bool isNativeCallable(llvm::Function *f);
+
+  /// Run the call to \arg function, which is defined in the module,
+  /// natively if the arguments and all objects of \arg state are concrete.
+  /// Return false, leaving the state untouched, if the call must be
+  /// interpreted.
+  bool callNative(ExecutionState &state, KInstruction *target,
+                  llvm::Function *function,
+                  std::vector< ref<Expr> > &arguments);
+
   ObjectState *bindObjectInState(ExecutionState &state, const MemoryObject *mo,
                                  bool isLocal, const Array *array = 0);
 
@@ -303,12 +377,12 @@ private:
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
+    return state.stack.back().locals.getWritable()[kf->getArgRegister(index)];
   }
 
   Cell& getDestCell(ExecutionState &state,
                     KInstruction *target) {
-    return state.stack.back().locals[target->dest];
+    return state.stack.back().locals.getWritable()[target->dest];
   }
 
   void bindLocal(KInstruction *target, 
@@ -339,6 +413,12 @@ private:
   /// function may fork state if the state has multiple seeds.
   void executeGetValue(ExecutionState &state, ref<Expr> e, KInstruction *target);
 
+  /// Get a value of \arg e under \arg seed. Solver queries are shared
+  /// through \arg cache by the seeds under which \arg e evaluates alike.
+  ref<ConstantExpr>
+  getSeedValue(ExecutionState &state, SeedInfo &seed, ref<Expr> e,
+               std::map< ref<Expr>, ref<ConstantExpr> > &cache);
+
   /// Get textual information regarding a memory address.
   std::string getAddressInfo(ExecutionState &state, ref<Expr> address) const;
 
@@ -349,6 +429,9 @@ private:
 
   // remove state from queue and delete
   void terminateState(ExecutionState &state);
+  // remove state from queue and delete, keeping its decisions to recreate
+  // it later
+  void retireState(ExecutionState &state);
   // call exit handler and terminate state
   void terminateStateEarly(ExecutionState &state, const llvm::Twine &message);
   // call exit handler and terminate state
@@ -371,6 +454,14 @@ private:
   /// bindModuleConstants - Initialize the module constant table.
   void bindModuleConstants();
 
+  /// Evaluate the constants which were added to the module since the
+  /// constant table was last extended.
+  void bindNewConstants();
+
+  /// Return the KFunction of \arg f, which must be defined, building it and
+  /// binding its constants on first use.
+  KFunction *getKFunction(llvm::Function *f);
+
   template <typename TypeIt>
   void computeOffsets(KGEPInstruction *kgepi, TypeIt ib, TypeIt ie);
 
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "ExternalDispatcher.h"
+#include "Memory.h"
 #include "klee/Config/Version.h"
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
@@ -27,6 +28,7 @@
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 0)
 #include "llvm/Target/TargetSelect.h"
@@ -36,8 +38,10 @@
 
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/InstIterator.h"
 #else
 #include "llvm/IR/CallSite.h"
+#include "llvm/IR/InstIterator.h"
 #endif
 
 #include <setjmp.h>
@@ -137,7 +141,7 @@ bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args
     }
 #endif
 
-    dispatcher = createDispatcher(f,i);
+    dispatcher = createDispatcher(f, i, 0);
 
     dispatchers.insert(std::make_pair(i, dispatcher));
 
@@ -155,6 +159,106 @@ bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args
   return runProtectedCall(dispatcher, args);
 }
 
+bool ExternalDispatcher::executeNativeCall(Function *f, Instruction *i,
+                                           uint64_t *args,
+                                           const GlobalObjectMap &globalObjects) {
+  Function *&dispatcher = nativeDispatchers[std::make_pair(i, f)];
+  if (!dispatcher) {
+    dispatcher = createDispatcher(f, i, getNativeFunction(f, globalObjects));
+    executionEngine->recompileAndRelinkFunction(dispatcher);
+  }
+
+  return runProtectedCall(dispatcher, args);
+}
+
+/// Copy \arg f, and the functions it reaches which have not been copied
+/// yet, into the dispatch module. Global variables become declarations
+/// bound to the addresses of their objects.
+Function *ExternalDispatcher::getNativeFunction(Function *f,
+                                                const GlobalObjectMap &globalObjects) {
+  std::map<const GlobalValue*, GlobalValue*>::iterator it =
+    nativeValues.find(f);
+  if (it != nativeValues.end())
+    return cast<Function>(it->second);
+
+  // Create all the new functions first, so calls between them (including
+  // recursive ones) can be remapped when the bodies are cloned.
+  std::vector<Function*> pending, worklist(1, f);
+  nativeValues[f] = 0;
+  while (!worklist.empty()) {
+    Function *src = worklist.back();
+    worklist.pop_back();
+
+    Function *dst = Function::Create(src->getFunctionType(),
+                                     GlobalValue::InternalLinkage,
+                                     src->getName(), dispatchModule);
+    dst->copyAttributesFrom(src);
+    nativeValues[src] = dst;
+    pending.push_back(src);
+
+    std::vector<const Value*> operands;
+    for (inst_iterator ii = inst_begin(src), ie = inst_end(src); ii != ie;
+         ++ii)
+      operands.insert(operands.end(), ii->op_begin(), ii->op_end());
+
+    while (!operands.empty()) {
+      const Value *v = operands.back();
+      operands.pop_back();
+
+      if (const llvm::ConstantExpr *ce = dyn_cast<llvm::ConstantExpr>(v)) {
+        operands.insert(operands.end(), ce->op_begin(), ce->op_end());
+        continue;
+      }
+      const GlobalValue *gv = dyn_cast<GlobalValue>(v);
+      if (!gv || nativeValues.count(gv))
+        continue;
+
+      if (Function *callee = dyn_cast<Function>(const_cast<GlobalValue*>(gv))) {
+        if (callee->isDeclaration()) {
+          nativeValues[gv] = cast<Function>(
+            dispatchModule->getOrInsertFunction(callee->getName(),
+                                                callee->getFunctionType(),
+                                                callee->getAttributes()));
+        } else {
+          nativeValues[gv] = 0;
+          worklist.push_back(callee);
+        }
+      } else if (const GlobalVariable *var = dyn_cast<GlobalVariable>(gv)) {
+        GlobalObjectMap::const_iterator mo = globalObjects.find(var);
+        assert(mo != globalObjects.end() && "global without an object");
+        GlobalVariable *decl =
+          new GlobalVariable(*dispatchModule,
+                             var->getType()->getElementType(),
+                             var->isConstant(), GlobalValue::ExternalLinkage,
+                             0, var->getName());
+        executionEngine->addGlobalMapping(
+          decl, (void*) (unsigned long) mo->second->address);
+        nativeValues[gv] = decl;
+      }
+    }
+  }
+
+  ValueToValueMapTy vmap;
+  for (std::map<const GlobalValue*, GlobalValue*>::iterator
+         it = nativeValues.begin(), ie = nativeValues.end(); it != ie; ++it)
+    vmap[it->first] = it->second;
+
+  for (std::vector<Function*>::iterator it = pending.begin(),
+         ie = pending.end(); it != ie; ++it) {
+    Function *src = *it, *dst = cast<Function>(nativeValues[src]);
+    Function::arg_iterator di = dst->arg_begin();
+    for (Function::arg_iterator ai = src->arg_begin(), ae = src->arg_end();
+         ai != ae; ++ai, ++di) {
+      di->setName(ai->getName());
+      vmap[ai] = di;
+    }
+    SmallVector<ReturnInst*, 8> returns;
+    CloneFunctionInto(dst, src, vmap, true, returns);
+  }
+
+  return cast<Function>(nativeValues[f]);
+}
+
 // FIXME: This is not reentrant.
 static uint64_t *gTheArgsP;
 
@@ -191,8 +295,10 @@ bool ExternalDispatcher::runProtectedCall(Function *f, uint64_t *args) {
 // the special cases that the JIT knows how to directly call. If this is not
 // done, then the jit will end up generating a nullary stub just to call our
 // stub, for every single function call.
-Function *ExternalDispatcher::createDispatcher(Function *target, Instruction *inst) {
-  if (!resolveSymbol(target->getName()))
+Function *ExternalDispatcher::createDispatcher(Function *target,
+                                              Instruction *inst,
+                                              Function *definition) {
+  if (!definition && !resolveSymbol(target->getName()))
     return 0;
 
   CallSite cs;
@@ -250,9 +356,11 @@ Function *ExternalDispatcher::createDispatcher(Function *target, Instruction *in
     idx += ((!!argSize ? argSize : 64) + 63)/64;
   }
 
-  Constant *dispatchTarget =
-    dispatchModule->getOrInsertFunction(target->getName(), FTy,
-                                        target->getAttributes());
+  Constant *dispatchTarget = definition;
+  if (!dispatchTarget)
+    dispatchTarget =
+      dispatchModule->getOrInsertFunction(target->getName(), FTy,
+                                          target->getAttributes());
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
   Instruction *result = CallInst::Create(dispatchTarget,
                                          llvm::ArrayRef<Value *>(args, args+i),
@@ -16,6 +16,7 @@
 
 namespace llvm {
   class ExecutionEngine;
+  class GlobalValue;
   class Instruction;
   class Function;
   class FunctionType;
@@ -23,15 +24,31 @@ namespace llvm {
 }
 
 namespace klee {
+  class MemoryObject;
+
   class ExternalDispatcher {
+  public:
+    typedef std::map<const llvm::GlobalValue*, MemoryObject*> GlobalObjectMap;
+
   private:
     typedef std::map<const llvm::Instruction*,llvm::Function*> dispatchers_ty;
     dispatchers_ty dispatchers;
     llvm::Module *dispatchModule;
     llvm::ExecutionEngine *executionEngine;
     std::map<std::string, void*> preboundFunctions;
-    
-    llvm::Function *createDispatcher(llvm::Function *f, llvm::Instruction *i);
+
+    /// Dispatchers for native calls, by call site and callee since an
+    /// indirect call site may reach several functions.
+    std::map<std::pair<const llvm::Instruction*, const llvm::Function*>,
+             llvm::Function*> nativeDispatchers;
+    /// The copies in the dispatch module of the functions and global
+    /// variables of the module being executed.
+    std::map<const llvm::GlobalValue*, llvm::GlobalValue*> nativeValues;
+
+    llvm::Function *createDispatcher(llvm::Function *f, llvm::Instruction *i,
+                                     llvm::Function *definition);
+    llvm::Function *getNativeFunction(llvm::Function *f,
+                                      const GlobalObjectMap &globalObjects);
     bool runProtectedCall(llvm::Function *f, uint64_t *args);
     
   public:
@@ -43,6 +60,16 @@ namespace klee {
      * into args[0].
      */
     bool executeCall(llvm::Function *function, llvm::Instruction *i, uint64_t *args);
+
+    /// Call \arg function, which is defined in the module being executed,
+    /// natively with the same conventions as executeCall. The function and
+    /// the functions it calls, which must all be defined in the module or
+    /// be intrinsics, are compiled on first use. Global variables are
+    /// accessed at the addresses of their objects in \arg globalObjects,
+    /// so the caller must copy the concrete memory out and back in.
+    bool executeNativeCall(llvm::Function *function, llvm::Instruction *i,
+                           uint64_t *args,
+                           const GlobalObjectMap &globalObjects);
     void *resolveSymbol(const std::string &name);
   };  
 }
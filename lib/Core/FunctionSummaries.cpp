@@ -0,0 +1,162 @@
+//===-- FunctionSummaries.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "FunctionSummaries.h"
+
+#include "Context.h"
+#include "Memory.h"
+
+#include "klee/ExecutionState.h"
+
+using namespace klee;
+
+/// The number of summaries kept per function and arguments.
+static const unsigned MaxSummariesPerCall = 8;
+
+/// Recordings reading more than this are abandoned, the call is unlikely
+/// to be a small helper and its footprint would be costly to check.
+static const unsigned MaxSummaryReads = 4096;
+
+bool FunctionSummaries::matches(ExecutionState &state,
+                                const Summary &summary) const {
+  Expr::Width pointerWidth = Context::get().getPointerWidth();
+  for (std::vector<Read>::const_iterator it = summary.reads.begin(),
+         ie = summary.reads.end(); it != ie; ++it) {
+    ObjectPair op;
+    if (!state.addressSpace.resolveOne(ConstantExpr::create(it->address,
+                                                            pointerWidth),
+                                       op))
+      return false;
+    if (op.first->id != it->id || op.first->address != it->address)
+      return false;
+
+    ref<Expr> value = op.second->read(it->offset, it->value->getWidth());
+    ConstantExpr *ce = dyn_cast<ConstantExpr>(value);
+    if (!ce || ce->getAPValue() != it->value->getAPValue())
+      return false;
+  }
+  return true;
+}
+
+bool FunctionSummaries::lookup(ExecutionState &state,
+                               const KFunction *kf,
+                               const std::vector< ref<Expr> > &arguments,
+                               ref<Expr> &result) {
+  if (summaries.empty())
+    return false;
+
+  std::map<Key, std::vector<Summary> >::iterator it =
+    summaries.find(Key(kf, arguments));
+  if (it == summaries.end())
+    return false;
+
+  for (std::vector<Summary>::iterator si = it->second.begin(),
+         se = it->second.end(); si != se; ++si) {
+    if (matches(state, *si)) {
+      result = si->result;
+      ++hits;
+      // A call recording around this one depends on the same footprint.
+      std::map<const ExecutionState*, Recording>::iterator ri =
+        recordings.find(&state);
+      if (ri != recordings.end()) {
+        Recording &r = ri->second;
+        for (std::vector<Read>::iterator it = si->reads.begin(),
+               ie = si->reads.end(); it != ie; ++it) {
+          if (it->id >= r.firstObjectId)
+            continue;
+          if (r.reads.size() == MaxSummaryReads) {
+            recordings.erase(ri);
+            break;
+          }
+          r.reads.push_back(*it);
+        }
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void FunctionSummaries::callEntered(const ExecutionState &state,
+                                    const KFunction *kf,
+                                    const std::vector< ref<Expr> > &arguments) {
+  if (recordings.count(&state))
+    return;
+  for (std::vector< ref<Expr> >::const_iterator it = arguments.begin(),
+         ie = arguments.end(); it != ie; ++it)
+    if (!isa<ConstantExpr>(*it))
+      return;
+
+  Recording &r = recordings[&state];
+  r.key = Key(kf, arguments);
+  r.depth = state.stack.size();
+  r.firstObjectId = MemoryObject::counter;
+}
+
+void FunctionSummaries::callReturned(const ExecutionState &state,
+                                     ref<Expr> result) {
+  if (recordings.empty())
+    return;
+  std::map<const ExecutionState*, Recording>::iterator it =
+    recordings.find(&state);
+  // The frame has been popped already.
+  if (it == recordings.end() || state.stack.size() + 1 != it->second.depth)
+    return;
+
+  Recording &r = it->second;
+  if (result.isNull() || isa<ConstantExpr>(result)) {
+    std::vector<Summary> &entries = summaries[r.key];
+    if (entries.size() < MaxSummariesPerCall) {
+      entries.push_back(Summary());
+      entries.back().reads.swap(r.reads);
+      entries.back().result = result;
+      ++recorded;
+    }
+  }
+  recordings.erase(it);
+}
+
+void FunctionSummaries::memoryRead(const ExecutionState &state,
+                                   const MemoryObject *mo,
+                                   ref<Expr> offset, ref<Expr> value) {
+  if (recordings.empty())
+    return;
+  std::map<const ExecutionState*, Recording>::iterator it =
+    recordings.find(&state);
+  if (it == recordings.end())
+    return;
+
+  Recording &r = it->second;
+  if (mo->id >= r.firstObjectId)
+    return;
+
+  ConstantExpr *co = dyn_cast<ConstantExpr>(offset);
+  ConstantExpr *cv = dyn_cast<ConstantExpr>(value);
+  if (!co || !cv || r.reads.size() == MaxSummaryReads) {
+    recordings.erase(it);
+    return;
+  }
+
+  Read read;
+  read.address = mo->address;
+  read.id = mo->id;
+  read.offset = co->getZExtValue();
+  read.value = cv;
+  r.reads.push_back(read);
+}
+
+void FunctionSummaries::memoryWritten(const ExecutionState &state,
+                                      const MemoryObject *mo) {
+  if (recordings.empty())
+    return;
+  std::map<const ExecutionState*, Recording>::iterator it =
+    recordings.find(&state);
+  if (it != recordings.end() && mo->id < it->second.firstObjectId)
+    recordings.erase(it);
+}
@@ -0,0 +1,107 @@
+//===-- FunctionSummaries.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FUNCTIONSUMMARIES_H
+#define KLEE_FUNCTIONSUMMARIES_H
+
+#include "klee/Expr.h"
+
+#include <map>
+#include <vector>
+
+#include <stdint.h>
+
+namespace klee {
+  class ExecutionState;
+  struct KFunction;
+  class MemoryObject;
+
+  /// FunctionSummaries - Reuses the results of calls which only depend on
+  /// concrete inputs.
+  ///
+  /// When a state calls a function with constant arguments and is not
+  /// already recording a call, the call is recorded: the constant values it
+  /// reads from objects which existed before the call form the summary's
+  /// footprint. If the call returns a constant without forking on a
+  /// symbolic condition, writing to or reading symbolic data from those
+  /// objects, allocating heap memory or calling external code, the result
+  /// is kept. A later call with the same arguments, in any state where the
+  /// footprint reads the same values, returns the result at once.
+  class FunctionSummaries {
+    struct Read {
+      /// Base address and id of the object, the id guards against the
+      /// address being reused by a later object.
+      uint64_t address;
+      unsigned id;
+      unsigned offset;
+      ref<ConstantExpr> value;
+    };
+
+    struct Summary {
+      std::vector<Read> reads;
+      /// The returned value, null for void functions.
+      ref<Expr> result;
+    };
+
+    typedef std::pair<const KFunction*, std::vector< ref<Expr> > > Key;
+
+    struct Recording {
+      Key key;
+      /// The stack depth of the recorded call's frame.
+      unsigned depth;
+      /// Objects with an id from this one on were allocated by the call.
+      unsigned firstObjectId;
+      std::vector<Read> reads;
+    };
+
+    std::map<Key, std::vector<Summary> > summaries;
+    std::map<const ExecutionState*, Recording> recordings;
+
+    unsigned hits, recorded;
+
+    bool matches(ExecutionState &state, const Summary &summary) const;
+
+  public:
+    FunctionSummaries() : hits(0), recorded(0) {}
+
+    /// Find the result of calling \arg kf with \arg arguments in \arg
+    /// state. Return false if no summary applies.
+    bool lookup(ExecutionState &state, const KFunction *kf,
+                const std::vector< ref<Expr> > &arguments,
+                ref<Expr> &result);
+
+    /// Start recording the call of \arg kf whose frame was just pushed,
+    /// unless \arg state is recording already or an argument is symbolic.
+    void callEntered(const ExecutionState &state, const KFunction *kf,
+                     const std::vector< ref<Expr> > &arguments);
+
+    /// Note that a frame of \arg state returned \arg result (null if the
+    /// function returns nothing), ending the recorded call if it was its
+    /// frame.
+    void callReturned(const ExecutionState &state, ref<Expr> result);
+
+    /// Note that \arg state read \arg value at \arg offset of \arg mo.
+    void memoryRead(const ExecutionState &state, const MemoryObject *mo,
+                    ref<Expr> offset, ref<Expr> value);
+
+    /// Note that \arg state wrote to \arg mo.
+    void memoryWritten(const ExecutionState &state, const MemoryObject *mo);
+
+    /// Stop recording the call of \arg state, it cannot be summarized.
+    void abort(const ExecutionState &state) {
+      if (!recordings.empty())
+        recordings.erase(&state);
+    }
+
+    unsigned getHits() const { return hits; }
+    unsigned getNumRecorded() const { return recorded; }
+  };
+}
+
+#endif
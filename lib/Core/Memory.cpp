@@ -136,6 +136,20 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
   memset(concreteStore, 0, size);
 }
 
+ObjectState::ObjectState(const MemoryObject *mo, const UpdateList &_updates)
+  : copyOnWriteOwner(0),
+    refCount(0),
+    object(mo),
+    concreteStore(new uint8_t[mo->size]),
+    concreteMask(0),
+    flushMask(0),
+    knownSymbolics(0),
+    updates(_updates),
+    size(mo->size),
+    readOnly(false) {
+  mo->refCount++;
+}
+
 ObjectState::ObjectState(const ObjectState &os) 
   : copyOnWriteOwner(0),
     refCount(0),
@@ -334,6 +348,15 @@ void ObjectState::flushRangeForWrite(unsigned rangeBase,
   } 
 }
 
+bool ObjectState::isConcrete() const {
+  if (!concreteMask)
+    return true;
+  for (unsigned i = 0; i != size; ++i)
+    if (!concreteMask->get(i))
+      return false;
+  return true;
+}
+
 bool ObjectState::isByteConcrete(unsigned offset) const {
   return !concreteMask || concreteMask->get(offset);
 }
@@ -382,6 +405,18 @@ void ObjectState::setKnownSymbolic(unsigned offset,
   }
 }
 
+void ObjectState::markRangeConcrete(unsigned offset, unsigned len) {
+  // Fully concrete objects have no cache to update.
+  if (!concreteMask && !flushMask && !knownSymbolics)
+    return;
+
+  for (unsigned i = offset, e = offset + len; i != e; ++i) {
+    setKnownSymbolic(i, 0);
+    markByteConcrete(i);
+    markByteUnflushed(i);
+  }
+}
+
 /***/
 
 ref<Expr> ObjectState::read8(unsigned offset) const {
@@ -583,6 +618,49 @@ void ObjectState::write64(unsigned offset, uint64_t value) {
   }
 }
 
+void ObjectState::copy(unsigned offset, const ObjectState &src,
+                       unsigned srcOffset, unsigned len) {
+  assert(offset + len <= size && srcOffset + len <= src.size &&
+         "copy out of bounds");
+
+  bool concrete = true;
+  if (src.concreteMask)
+    for (unsigned i = srcOffset, e = srcOffset + len; i != e; ++i)
+      if (!src.isByteConcrete(i)) {
+        concrete = false;
+        break;
+      }
+
+  if (concrete) {
+    memmove(concreteStore + offset, src.concreteStore + srcOffset, len);
+    markRangeConcrete(offset, len);
+    return;
+  }
+
+  // Go backwards when the destination overlaps the end of the source, so
+  // every byte is read before it is overwritten.
+  if (&src == this && srcOffset < offset) {
+    for (unsigned i = len; i != 0; --i)
+      write8(offset + i - 1, src.read8(srcOffset + i - 1));
+  } else {
+    for (unsigned i = 0; i != len; ++i)
+      write8(offset + i, src.read8(srcOffset + i));
+  }
+}
+
+void ObjectState::fill(unsigned offset, ref<Expr> value, unsigned len) {
+  assert(offset + len <= size && "fill out of bounds");
+  assert(value->getWidth() == Expr::Int8 && "invalid fill value width");
+
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
+    memset(concreteStore + offset, CE->getZExtValue(8), len);
+    markRangeConcrete(offset, len);
+  } else {
+    for (unsigned i = 0; i != len; ++i)
+      write8(offset + i, value);
+  }
+}
+
 void ObjectState::print() {
   llvm::errs() << "-- ObjectState --\n";
   llvm::errs() << "\tMemoryObject ID: " << object->id << "\n";
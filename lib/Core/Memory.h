@@ -32,6 +32,9 @@ class MemoryObject {
   friend class STPBuilder;
   friend class ObjectState;
   friend class ExecutionState;
+  friend class SymbolicList;
+  friend class FunctionSummaries;
+  friend class StateSwapper;
 
 private:
   static int counter;
@@ -153,6 +156,8 @@ private:
   friend class ObjectHolder;
   unsigned refCount;
 
+  friend class StateSwapper;
+
   const MemoryObject *object;
 
   uint8_t *concreteStore;
@@ -189,6 +194,9 @@ public:
 
   void setReadOnly(bool ro) { readOnly = ro; }
 
+  /// Return true if every byte of the object has a concrete value.
+  bool isConcrete() const;
+
   // make contents all concrete and zero
   void initializeToZero();
   // make contents all concrete and random
@@ -207,7 +215,20 @@ public:
   void write32(unsigned offset, uint32_t value);
   void write64(unsigned offset, uint64_t value);
 
+  /// Copy \arg len bytes at \arg srcOffset of \arg src to \arg offset,
+  /// as memmove would. \arg src may be this object.
+  void copy(unsigned offset, const ObjectState &src, unsigned srcOffset,
+            unsigned len);
+
+  /// Set \arg len bytes at \arg offset to the byte \arg value, as memset
+  /// would.
+  void fill(unsigned offset, ref<Expr> value, unsigned len);
+
 private:
+  /// Create an object state with the given updates and uninitialized
+  /// contents, used by StateSwapper to restore spilled objects.
+  ObjectState(const MemoryObject *mo, const UpdateList &updates);
+
   const UpdateList &getUpdates() const;
 
   void makeConcrete();
@@ -233,6 +254,9 @@ private:
   void markByteUnflushed(unsigned offset);
   void setKnownSymbolic(unsigned offset, Expr *value);
 
+  /// Update the byte cache after a concrete write to the range.
+  void markRangeConcrete(unsigned offset, unsigned len);
+
   void print();
 };
   
@@ -9,50 +9,155 @@
 
 #include "PTree.h"
 
-#include <klee/Expr.h>
-#include <klee/util/ExprPPrinter.h>
-
 #include <vector>
 
 using namespace klee;
 
   /* *** */
 
-PTree::PTree(const data_type &_root) : root(new Node(0,_root)) {
+PTree::PTree(const data_type &_root) : nextNode(1), root(0) {
+  root = allocate(0, _root);
+}
+
+PTree::~PTree() {
+  for (std::vector<Node*>::iterator it = chunks.begin(), ie = chunks.end();
+       it != ie; ++it)
+    delete[] *it;
+}
+
+PTreeNode *PTree::allocate(NodeIndex parent, const data_type &data) {
+  NodeIndex index;
+  if (!freeNodes.empty()) {
+    index = freeNodes.back();
+    freeNodes.pop_back();
+  } else {
+    index = nextNode++;
+    if ((index >> ChunkBits) == chunks.size())
+      chunks.push_back(new Node[ChunkSize]);
+  }
+
+  Node *n = getNode(index);
+  n->data = data;
+  n->alive = 1;
+  n->minDistToUncovered = 0;
+  n->queryCost = 0.;
+  n->index = index;
+  n->parent = parent;
+  n->left = n->right = 0;
+  return n;
 }
 
-PTree::~PTree() {}
+void PTree::release(Node *n) {
+  n->data = 0;
+  n->alive = 0;
+  n->minDistToUncovered = 0;
+  n->queryCost = 0.;
+  n->parent = n->left = n->right = 0;
+  freeNodes.push_back(n->index);
+}
 
 std::pair<PTreeNode*, PTreeNode*>
 PTree::split(Node *n, 
              const data_type &leftData, 
              const data_type &rightData) {
   assert(n && !n->left && !n->right);
-  n->left = new Node(n, leftData);
-  n->right = new Node(n, rightData);
-  return std::make_pair(n->left, n->right);
+  Node *left = allocate(n->index, leftData);
+  Node *right = allocate(n->index, rightData);
+  n->left = left->index;
+  n->right = right->index;
+
+  // Both states start out from the metrics of the forked one.
+  left->minDistToUncovered = right->minDistToUncovered = n->minDistToUncovered;
+  left->queryCost = right->queryCost = n->queryCost;
+  updateAggregates(n);
+
+  return std::make_pair(left, right);
 }
 
 void PTree::remove(Node *n) {
   assert(!n->left && !n->right);
-  do {
-    Node *p = n->parent;
-    delete n;
-    if (p) {
-      if (n == p->left) {
-        p->left = 0;
-      } else {
-        assert(n == p->right);
-        p->right = 0;
-      }
-    }
-    n = p;
-  } while (n && !n->left && !n->right);
+  NodeIndex index = n->index;
+  Node *p = getParent(n);
+  release(n);
+
+  if (!p) {
+    root = 0;
+    return;
+  }
+
+  // Splice out the fork, the surviving child takes its place.
+  Node *child = getNode(p->left == index ? p->right : p->left);
+  assert(child && "fork with a single child");
+  Node *grandparent = getParent(p);
+  child->parent = p->parent;
+  if (!grandparent) {
+    root = child;
+  } else if (grandparent->left == p->index) {
+    grandparent->left = child->index;
+  } else {
+    assert(grandparent->right == p->index);
+    grandparent->right = child->index;
+  }
+  release(p);
+
+  if (grandparent)
+    updateAggregates(grandparent);
+}
+
+PTreeNode *PTree::insert(const data_type &data) {
+  if (!root) {
+    root = allocate(0, data);
+    return root;
+  }
+
+  // The new leaf and the old tree become the children of a new root fork.
+  Node *fork = allocate(0, 0);
+  Node *leaf = allocate(fork->index, data);
+  root->parent = fork->index;
+  fork->left = root->index;
+  fork->right = leaf->index;
+  root = fork;
+  updateAggregates(fork);
+
+  return leaf;
+}
+
+void PTree::updateLeaf(Node *n, uint64_t minDistToUncovered,
+                       double queryCost) {
+  assert(n->data && "not a live state");
+  if (n->minDistToUncovered == minDistToUncovered &&
+      n->queryCost == queryCost)
+    return;
+
+  n->minDistToUncovered = minDistToUncovered;
+  n->queryCost = queryCost;
+  if (Node *p = getParent(n))
+    updateAggregates(p);
+}
+
+/// Recompute the aggregates of the fork \arg n and its ancestors from
+/// their children, stopping once they no longer change.
+void PTree::updateAggregates(Node *n) {
+  for (; n; n = getParent(n)) {
+    Node *left = getLeft(n), *right = getRight(n);
+    uint32_t alive = left->alive + right->alive;
+    uint64_t minDist = left->minDistToUncovered;
+    if (!minDist || (right->minDistToUncovered &&
+                     right->minDistToUncovered < minDist))
+      minDist = right->minDistToUncovered;
+    double queryCost = left->queryCost + right->queryCost;
+
+    if (alive == n->alive && minDist == n->minDistToUncovered &&
+        queryCost == n->queryCost)
+      return;
+
+    n->alive = alive;
+    n->minDistToUncovered = minDist;
+    n->queryCost = queryCost;
+  }
 }
 
 void PTree::dump(llvm::raw_ostream &os) {
-  ExprPPrinter *pp = ExprPPrinter::create(os);
-  pp->setNewline("\\l");
   os << "digraph G {\n";
   os << "\tsize=\"10,7.5\";\n";
   os << "\tratio=fill;\n";
@@ -61,42 +166,37 @@ void PTree::dump(llvm::raw_ostream &os) {
   os << "\tnode [style=\"filled\",width=.1,height=.1,fontname=\"Terminus\"]\n";
   os << "\tedge [arrowsize=.3]\n";
   std::vector<PTree::Node*> stack;
-  stack.push_back(root);
+  if (root)
+    stack.push_back(root);
   while (!stack.empty()) {
     PTree::Node *n = stack.back();
     stack.pop_back();
-    if (n->condition.isNull()) {
-      os << "\tn" << n << " [label=\"\"";
-    } else {
-      os << "\tn" << n << " [label=\"";
-      pp->print(n->condition);
-      os << "\",shape=diamond";
-    }
+    os << "\tn" << n << " [label=\"" << n->alive << "\"";
     if (n->data)
       os << ",fillcolor=green";
     os << "];\n";
-    if (n->left) {
-      os << "\tn" << n << " -> n" << n->left << ";\n";
-      stack.push_back(n->left);
+    if (Node *left = getLeft(n)) {
+      os << "\tn" << n << " -> n" << left << ";\n";
+      stack.push_back(left);
     }
-    if (n->right) {
-      os << "\tn" << n << " -> n" << n->right << ";\n";
-      stack.push_back(n->right);
+    if (Node *right = getRight(n)) {
+      os << "\tn" << n << " -> n" << right << ";\n";
+      stack.push_back(right);
     }
   }
   os << "}\n";
-  delete pp;
 }
 
-PTreeNode::PTreeNode(PTreeNode *_parent, 
-                     ExecutionState *_data) 
-  : parent(_parent),
+PTreeNode::PTreeNode()
+  : data(0),
+    alive(0),
+    minDistToUncovered(0),
+    queryCost(0.),
+    index(0),
+    parent(0),
     left(0),
-    right(0),
-    data(_data),
-    condition(0) {
+    right(0) {
 }
 
 PTreeNode::~PTreeNode() {
 }
-
@@ -12,38 +12,107 @@
 
 #include <klee/Expr.h>
 
+#include <vector>
+
 namespace klee {
   class ExecutionState;
 
+  /// PTree - The process tree: the leaves are the live states and every
+  /// internal node is a fork with two live subtrees. When one side of a
+  /// fork dies the fork is spliced out, so the tree never holds chains of
+  /// unary nodes and has exactly one internal node less than live states.
+  ///
+  /// Nodes live in a pool of fixed size chunks (so node pointers remain
+  /// valid) and are linked by 32-bit indices into the pool.
+  ///
+  /// Every node aggregates metrics over its subtree (live states, minimum
+  /// distance to uncovered code, total query cost). Leaf metrics are set
+  /// through updateLeaf and the aggregates are kept up to date on the
+  /// path to the root.
   class PTree { 
     typedef ExecutionState* data_type;
 
   public:
     typedef class PTreeNode Node;
+    /// Index of a node in the pool, 0 being the null node.
+    typedef uint32_t NodeIndex;
+
+  private:
+    static const unsigned ChunkBits = 10;
+    static const unsigned ChunkSize = 1 << ChunkBits;
+
+    std::vector<Node*> chunks;
+    std::vector<NodeIndex> freeNodes;
+    NodeIndex nextNode;
+
+    Node *allocate(NodeIndex parent, const data_type &data);
+    void release(Node *n);
+    void updateAggregates(Node *n);
+
+  public:
     Node *root;
 
     PTree(const data_type &_root);
     ~PTree();
     
+    Node *getNode(NodeIndex index) const;
+    Node *getParent(const Node *n) const;
+    Node *getLeft(const Node *n) const;
+    Node *getRight(const Node *n) const;
+
     std::pair<Node*,Node*> split(Node *n,
                                  const data_type &leftData,
                                  const data_type &rightData);
     void remove(Node *n);
 
+    /// Add a leaf for a state which was not forked from a live one, next
+    /// to the existing tree.
+    Node *insert(const data_type &data);
+
+    /// Set the metrics of the live state at leaf \arg n.
+    ///
+    /// \param minDistToUncovered - The distance of the state to uncovered
+    /// code, 0 if there is none.
+    /// \param queryCost - The query cost of the state.
+    void updateLeaf(Node *n, uint64_t minDistToUncovered, double queryCost);
+
     void dump(llvm::raw_ostream &os);
   };
 
   class PTreeNode {
     friend class PTree;
   public:
-    PTreeNode *parent, *left, *right;
     ExecutionState *data;
-    ref<Expr> condition;
+    /// The number of live states (leaves) in the subtree of this node.
+    uint32_t alive;
+    /// The least non-zero distance to uncovered code in the subtree, 0 if
+    /// none.
+    uint64_t minDistToUncovered;
+    /// The total query cost of the states in the subtree.
+    double queryCost;
 
   private:
-    PTreeNode(PTreeNode *_parent, ExecutionState *_data);
+    PTree::NodeIndex index, parent, left, right;
+
+    PTreeNode();
     ~PTreeNode();
   };
+
+  inline PTreeNode *PTree::getNode(NodeIndex index) const {
+    return index ? &chunks[index >> ChunkBits][index & (ChunkSize - 1)] : 0;
+  }
+
+  inline PTreeNode *PTree::getParent(const Node *n) const {
+    return getNode(n->parent);
+  }
+
+  inline PTreeNode *PTree::getLeft(const Node *n) const {
+    return getNode(n->left);
+  }
+
+  inline PTreeNode *PTree::getRight(const Node *n) const {
+    return getNode(n->right);
+  }
 }
 
 #endif
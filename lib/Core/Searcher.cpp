@@ -13,6 +13,7 @@
 
 #include "CoreStats.h"
 #include "Executor.h"
+#include "Memory.h"
 #include "PTree.h"
 #include "StatsTracker.h"
 
@@ -37,11 +38,14 @@
 #include "llvm/Support/CommandLine.h"
 
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+#include "llvm/Analysis/Dominators.h"
 #include "llvm/Support/CallSite.h"
 #else
 #include "llvm/IR/CallSite.h"
+#include "llvm/IR/Dominators.h"
 #endif
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <climits>
@@ -163,7 +167,8 @@ void RandomSearcher::update(ExecutionState *current,
 
 WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
   : states(new DiscretePDF<ExecutionState*>()),
-    type(_type) {
+    type(_type),
+    coverageEpoch(0) {
   switch(type) {
   case Depth: 
     updateWeights = false;
@@ -185,9 +190,76 @@ WeightedRandomSearcher::~WeightedRandomSearcher() {
 }
 
 ExecutionState &WeightedRandomSearcher::selectState() {
+  flushUpdates();
   return *states->choose(theRNG.getDoubleL());
 }
 
+WeightedRandomSearcher::WeightInputs
+WeightedRandomSearcher::getWeightInputs(ExecutionState *es) {
+  WeightInputs inputs;
+  switch(type) {
+  default:
+  case Depth:
+    break;
+  case InstCount:
+    inputs.location = es->pc;
+    inputs.count = 
+      theStatisticManager->getIndexedValue(stats::instructions,
+                                           es->pc->info->id);
+    break;
+  case CPInstCount: {
+    StackFrame &sf = es->stack.back();
+    inputs.location = sf.callPathNode;
+    inputs.count = sf.callPathNode->statistics.getValue(stats::instructions);
+    break;
+  }
+  case QueryCost:
+    inputs.queryCost = es->queryCost;
+    break;
+  case CoveringNew:
+    inputs.instsSinceCovNew = es->instsSinceCovNew;
+    // fall through
+  case MinDistToUncovered:
+    inputs.location = es->pc;
+    inputs.count = es->stack.back().minDistToUncoveredOnReturn;
+    inputs.coverageEpoch = stats::coveredInstructions;
+    break;
+  }
+  return inputs;
+}
+
+/// Bring the weights of the states touched since the last selection up to
+/// date, recomputing only those whose inputs changed.
+void WeightedRandomSearcher::flushUpdates() {
+  if (!updateWeights)
+    return;
+
+  // New coverage moves the distance to uncovered code of every state.
+  if (type == MinDistToUncovered || type == CoveringNew) {
+    uint64_t epoch = stats::coveredInstructions;
+    if (epoch != coverageEpoch) {
+      coverageEpoch = epoch;
+      pendingUpdates.clear();
+      for (std::map<ExecutionState*, WeightInputs>::iterator
+             it = weightInputs.begin(), ie = weightInputs.end();
+           it != ie; ++it)
+        pendingUpdates.push_back(it->first);
+    }
+  }
+
+  for (std::vector<ExecutionState*>::iterator it = pendingUpdates.begin(),
+         ie = pendingUpdates.end(); it != ie; ++it) {
+    ExecutionState *es = *it;
+    WeightInputs inputs = getWeightInputs(es);
+    WeightInputs &last = weightInputs[es];
+    if (inputs == last)
+      continue;
+    last = inputs;
+    states->update(es, getWeight(es));
+  }
+  pendingUpdates.clear();
+}
+
 double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   switch(type) {
   default:
@@ -228,18 +300,29 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
 void WeightedRandomSearcher::update(ExecutionState *current,
                                     const std::set<ExecutionState*> &addedStates,
                                     const std::set<ExecutionState*> &removedStates) {
-  if (current && updateWeights && !removedStates.count(current))
-    states->update(current, getWeight(current));
+  // Reweighting is deferred to the next selection.
+  if (current && updateWeights && !removedStates.count(current) &&
+      (pendingUpdates.empty() || pendingUpdates.back() != current))
+    pendingUpdates.push_back(current);
   
   for (std::set<ExecutionState*>::const_iterator it = addedStates.begin(),
          ie = addedStates.end(); it != ie; ++it) {
     ExecutionState *es = *it;
     states->insert(es, getWeight(es));
+    if (updateWeights)
+      weightInputs[es] = getWeightInputs(es);
   }
 
   for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
          ie = removedStates.end(); it != ie; ++it) {
-    states->remove(*it);
+    ExecutionState *es = *it;
+    states->remove(es);
+    if (updateWeights) {
+      weightInputs.erase(es);
+      pendingUpdates.erase(std::remove(pendingUpdates.begin(),
+                                       pendingUpdates.end(), es),
+                           pendingUpdates.end());
+    }
   }
 }
 
@@ -258,21 +341,17 @@ RandomPathSearcher::~RandomPathSearcher() {
 
 ExecutionState &RandomPathSearcher::selectState() {
   unsigned flips=0, bits=0;
-  PTree::Node *n = executor.processTree->root;
+  PTree *tree = executor.processTree;
+  PTree::Node *n = tree->root;
   
+  // The tree is compacted, so every internal node is a fork.
   while (!n->data) {
-    if (!n->left) {
-      n = n->right;
-    } else if (!n->right) {
-      n = n->left;
-    } else {
-      if (bits==0) {
-        flips = theRNG.getInt32();
-        bits = 32;
-      }
-      --bits;
-      n = (flips&(1<<bits)) ? n->left : n->right;
+    if (bits==0) {
+      flips = theRNG.getInt32();
+      bits = 32;
     }
+    --bits;
+    n = (flips&(1<<bits)) ? tree->getLeft(n) : tree->getRight(n);
   }
 
   return *n->data;
@@ -289,6 +368,73 @@ bool RandomPathSearcher::empty() {
 
 ///
 
+WeightedRandomPathSearcher::WeightedRandomPathSearcher(Executor &_executor,
+                                                       WeightType _type)
+  : executor(_executor),
+    type(_type) {
+}
+
+WeightedRandomPathSearcher::~WeightedRandomPathSearcher() {
+}
+
+double WeightedRandomPathSearcher::getWeight(PTreeNode *n) {
+  switch(type) {
+  default:
+  case MinDistToUncovered: {
+    uint64_t md2u = n->minDistToUncovered;
+    double invMD2U = 1. / (md2u ? md2u : 10000);
+    return invMD2U * invMD2U;
+  }
+  case QueryCost: {
+    double cost = n->queryCost / n->alive;
+    return (cost < .1) ? 1. : 1./cost;
+  }
+  }
+}
+
+ExecutionState &WeightedRandomPathSearcher::selectState() {
+  PTree *tree = executor.processTree;
+  PTree::Node *n = tree->root;
+
+  while (!n->data) {
+    PTree::Node *left = tree->getLeft(n), *right = tree->getRight(n);
+    double leftWeight = getWeight(left), rightWeight = getWeight(right);
+    if (theRNG.getDoubleL() * (leftWeight + rightWeight) < leftWeight)
+      n = left;
+    else
+      n = right;
+  }
+
+  return *n->data;
+}
+
+/// Refresh the metrics of \arg es in the process tree.
+void WeightedRandomPathSearcher::updateLeaf(ExecutionState *es) {
+  PTree::Node *n = es->ptreeNode;
+  uint64_t md2u = n->minDistToUncovered;
+  if (type == MinDistToUncovered)
+    md2u = computeMinDistToUncovered(es->pc,
+                                     es->stack.back().minDistToUncoveredOnReturn);
+  executor.processTree->updateLeaf(n, md2u, es->queryCost);
+}
+
+void WeightedRandomPathSearcher::update(ExecutionState *current,
+                                        const std::set<ExecutionState*> &addedStates,
+                                        const std::set<ExecutionState*> &removedStates) {
+  if (current && !removedStates.count(current))
+    updateLeaf(current);
+
+  for (std::set<ExecutionState*>::const_iterator it = addedStates.begin(),
+         ie = addedStates.end(); it != ie; ++it)
+    updateLeaf(*it);
+}
+
+bool WeightedRandomPathSearcher::empty() { 
+  return executor.states.empty(); 
+}
+
+///
+
 BumpMergingSearcher::BumpMergingSearcher(Executor &_executor, Searcher *_baseSearcher) 
   : executor(_executor),
     baseSearcher(_baseSearcher),
@@ -495,6 +641,420 @@ void MergingSearcher::update(ExecutionState *current,
 
 ///
 
+RegionMergingSearcher::RegionMergingSearcher(Executor &_executor,
+                                             Searcher *_baseSearcher,
+                                             unsigned _maxBlocks)
+  : executor(_executor),
+    baseSearcher(_baseSearcher),
+    maxBlocks(_maxBlocks),
+    nextRegionId(0) {
+}
+
+RegionMergingSearcher::~RegionMergingSearcher() {
+  delete baseSearcher;
+}
+
+/// Check that no path from \arg entry loops back before reaching \arg
+/// exit, and that at most \arg maxBlocks blocks lie on those paths.
+static bool isAcyclicRegion(BasicBlock *entry, BasicBlock *exit,
+                            unsigned maxBlocks) {
+  // 1: on the DFS stack, 2: finished
+  std::map<BasicBlock*, unsigned> visited;
+  std::vector<std::pair<BasicBlock*, unsigned> > stack;
+  unsigned blocks = 1;
+
+  visited[entry] = 1;
+  stack.push_back(std::make_pair(entry, 0u));
+  while (!stack.empty()) {
+    BasicBlock *bb = stack.back().first;
+    unsigned i = stack.back().second++;
+    TerminatorInst *term = bb->getTerminator();
+    if (i == term->getNumSuccessors()) {
+      visited[bb] = 2;
+      stack.pop_back();
+      continue;
+    }
+
+    BasicBlock *succ = term->getSuccessor(i);
+    if (succ == exit)
+      continue;
+    unsigned &state = visited[succ];
+    if (state == 1)
+      return false;
+    if (state == 2)
+      continue;
+    if (++blocks > maxBlocks)
+      return false;
+    state = 1;
+    stack.push_back(std::make_pair(succ, 0u));
+  }
+
+  return true;
+}
+
+void RegionMergingSearcher::analyzeFunction(Function *f) {
+  DominatorTreeBase<BasicBlock> pdt(true);
+  pdt.recalculate(*f);
+
+  for (Function::iterator bbit = f->begin(), bbie = f->end();
+       bbit != bbie; ++bbit) {
+    BasicBlock *bb = bbit;
+    TerminatorInst *term = bb->getTerminator();
+    if (!isa<BranchInst>(term) && !isa<SwitchInst>(term))
+      continue;
+    if (term->getNumSuccessors() < 2)
+      continue;
+
+    // The region ends at the immediate post-dominator of the branch, the
+    // first block every path from the branch goes through.
+    DomTreeNode *node = pdt.getNode(bb);
+    if (!node || !node->getIDom())
+      continue;
+    BasicBlock *exit = node->getIDom()->getBlock();
+    if (!exit || exit == bb)
+      continue;
+
+    if (isAcyclicRegion(bb, exit, maxBlocks))
+      mergePoints[term] = exit->getFirstNonPHI();
+  }
+}
+
+Instruction *RegionMergingSearcher::getMergePoint(Instruction *i) {
+  if (!isa<BranchInst>(i) && !isa<SwitchInst>(i))
+    return 0;
+
+  Function *f = i->getParent()->getParent();
+  if (analyzedFunctions.insert(f).second)
+    analyzeFunction(f);
+
+  std::map<Instruction*, Instruction*>::iterator it = mergePoints.find(i);
+  return it == mergePoints.end() ? 0 : it->second;
+}
+
+void RegionMergingSearcher::leaveRegion(unsigned id) {
+  std::map<unsigned, unsigned>::iterator it = runningStates.find(id);
+  assert(it != runningStates.end() && it->second && "invalid region count");
+  if (--it->second)
+    return;
+
+  runningStates.erase(it);
+  if (heldStates.count(id))
+    readyRegions.push_back(id);
+}
+
+void RegionMergingSearcher::releaseRegion(unsigned id) {
+  std::map<unsigned, std::vector<ExecutionState*> >::iterator it =
+    heldStates.find(id);
+  if (it == heldStates.end())
+    return;
+
+  std::vector<ExecutionState*> states;
+  states.swap(it->second);
+  heldStates.erase(it);
+
+  if (DebugLogMerge)
+    llvm::errs() << "-- releasing region " << id << " ("
+                 << states.size() << " states) --\n";
+
+  for (std::vector<ExecutionState*>::iterator it = states.begin(),
+         ie = states.end(); it != ie; ++it)
+    held.erase(*it);
+
+  for (unsigned i = 0, e = states.size(); i != e; ++i) {
+    ExecutionState *base = states[i];
+    if (!base)
+      continue;
+
+    for (unsigned j = i + 1; j != e; ++j) {
+      ExecutionState *mergeWith = states[j];
+      if (!mergeWith || !base->merge(*mergeWith))
+        continue;
+
+      if (DebugLogMerge)
+        llvm::errs() << "\tmerged: " << base << " with " << mergeWith << "\n";
+
+      // The merged state is no longer known to the base searcher; its
+      // removal is filtered out in update().
+      mergedStates.insert(mergeWith);
+      executor.terminateState(*mergeWith);
+      states[j] = 0;
+    }
+
+    baseSearcher->addState(base);
+  }
+}
+
+ExecutionState &RegionMergingSearcher::selectState() {
+  for (;;) {
+    while (!readyRegions.empty()) {
+      unsigned id = readyRegions.back();
+      readyRegions.pop_back();
+      releaseRegion(id);
+    }
+
+    // When every state waits at a merge point, release the oldest region.
+    if (!heldStates.empty() &&
+        (baseSearcher->empty() || held.size() == executor.states.size())) {
+      releaseRegion(heldStates.begin()->first);
+      continue;
+    }
+
+    ExecutionState &es = baseSearcher->selectState();
+
+    // Searchers walking the process tree may still pick held states; merge
+    // whatever has arrived so far instead of stalling.
+    std::map<ExecutionState*, unsigned>::iterator hit = held.find(&es);
+    if (hit != held.end()) {
+      releaseRegion(hit->second);
+      continue;
+    }
+
+    std::vector<RegionEntry> &regions = stateRegions[&es];
+    unsigned depth = es.stack.size();
+
+    // Returning from the function of a region leaves it.
+    while (!regions.empty() && regions.back().depth > depth) {
+      leaveRegion(regions.back().id);
+      regions.pop_back();
+    }
+
+    if (!regions.empty() && regions.back().depth == depth &&
+        regions.back().mergePoint == es.pc->inst) {
+      unsigned id = regions.back().id;
+      regions.pop_back();
+
+      // Nothing to merge with when the state is the last one of its region.
+      if (runningStates[id] == 1 && !heldStates.count(id)) {
+        leaveRegion(id);
+      } else {
+        baseSearcher->removeState(&es, &es);
+        held.insert(std::make_pair(&es, id));
+        heldStates[id].push_back(&es);
+        leaveRegion(id);
+        continue;
+      }
+    }
+
+    if (Instruction *mp = getMergePoint(es.pc->inst)) {
+      unsigned id = nextRegionId++;
+      regions.push_back(RegionEntry(id, mp, depth));
+      runningStates[id] = 1;
+    }
+
+    return es;
+  }
+}
+
+void RegionMergingSearcher::update(ExecutionState *current,
+                                   const std::set<ExecutionState*> &addedStates,
+                                   const std::set<ExecutionState*> &removedStates) {
+  // States forked inside a region belong to it as well.
+  if (current && !addedStates.empty()) {
+    std::map<ExecutionState*, std::vector<RegionEntry> >::iterator it =
+      stateRegions.find(current);
+    if (it != stateRegions.end() && !it->second.empty()) {
+      for (std::set<ExecutionState*>::const_iterator ait = addedStates.begin(),
+             aie = addedStates.end(); ait != aie; ++ait) {
+        stateRegions[*ait] = it->second;
+        for (std::vector<RegionEntry>::iterator rit = it->second.begin(),
+               rie = it->second.end(); rit != rie; ++rit)
+          ++runningStates[rit->id];
+      }
+    }
+  }
+
+  if (removedStates.empty()) {
+    baseSearcher->update(current, addedStates, removedStates);
+    return;
+  }
+
+  std::set<ExecutionState*> alt = removedStates;
+  for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
+         ie = removedStates.end(); it != ie; ++it) {
+    ExecutionState *es = *it;
+
+    std::map<ExecutionState*, std::vector<RegionEntry> >::iterator rit =
+      stateRegions.find(es);
+    if (rit != stateRegions.end()) {
+      for (std::vector<RegionEntry>::iterator eit = rit->second.begin(),
+             eie = rit->second.end(); eit != eie; ++eit)
+        leaveRegion(eit->id);
+      stateRegions.erase(rit);
+    }
+
+    // Held and merged states are not in the base searcher.
+    std::map<ExecutionState*, unsigned>::iterator hit = held.find(es);
+    if (hit != held.end()) {
+      std::vector<ExecutionState*> &states = heldStates[hit->second];
+      states.erase(std::find(states.begin(), states.end(), es));
+      if (states.empty())
+        heldStates.erase(hit->second);
+      held.erase(hit);
+      alt.erase(es);
+    } else if (mergedStates.erase(es)) {
+      alt.erase(es);
+    }
+  }
+
+  baseSearcher->update(current, addedStates, alt);
+}
+
+///
+
+DynamicMergingSearcher::DynamicMergingSearcher(Executor &_executor,
+                                               Searcher *_baseSearcher,
+                                               unsigned _maxCost)
+  : executor(_executor),
+    baseSearcher(_baseSearcher),
+    maxCost(_maxCost) {
+}
+
+DynamicMergingSearcher::~DynamicMergingSearcher() {
+  delete baseSearcher;
+}
+
+void DynamicMergingSearcher::index(ExecutionState *es) {
+  uint64_t fingerprint = es->getMergeFingerprint();
+  std::map<ExecutionState*, uint64_t>::iterator it = fingerprints.find(es);
+  if (it != fingerprints.end()) {
+    if (it->second == fingerprint)
+      return;
+    unindex(es);
+  }
+
+  fingerprints[es] = fingerprint;
+  candidates[fingerprint].insert(es);
+}
+
+void DynamicMergingSearcher::unindex(ExecutionState *es) {
+  std::map<ExecutionState*, uint64_t>::iterator it = fingerprints.find(es);
+  if (it == fingerprints.end())
+    return;
+
+  std::map<uint64_t, std::set<ExecutionState*> >::iterator cit =
+    candidates.find(it->second);
+  cit->second.erase(es);
+  if (cit->second.empty())
+    candidates.erase(cit);
+  fingerprints.erase(it);
+}
+
+unsigned DynamicMergingSearcher::estimateMergeCost(const ExecutionState &a,
+                                                   const ExecutionState &b,
+                                                   unsigned limit) {
+  // A value concrete in both states becomes symbolic when merged.
+  const unsigned ConcreteWeight = 4;
+
+  // The constraints past the common prefix end up in the disjunction.
+  ConstraintManager::constraint_iterator ai = a.constraints.begin();
+  ConstraintManager::constraint_iterator bi = b.constraints.begin();
+  while (ai != a.constraints.end() && bi != b.constraints.end() &&
+         ai->get() == bi->get()) {
+    ++ai;
+    ++bi;
+  }
+  unsigned cost = (a.constraints.end() - ai) + (b.constraints.end() - bi);
+  if (cost > limit)
+    return cost;
+
+  ExecutionState::stack_ty::const_iterator fa = a.stack.begin();
+  ExecutionState::stack_ty::const_iterator fb = b.stack.begin();
+  for (; fa != a.stack.end() && fb != b.stack.end(); ++fa, ++fb) {
+    if (fa->kf != fb->kf)
+      return limit + 1;
+    for (unsigned i = 0; i < fa->kf->numRegisters; ++i) {
+      const ref<Expr> &av = (*fa->locals)[i].value;
+      const ref<Expr> &bv = (*fb->locals)[i].value;
+      if (av.isNull() || bv.isNull() || av == bv)
+        continue;
+      cost += (isa<ConstantExpr>(av) && isa<ConstantExpr>(bv)) ?
+        ConcreteWeight : 1;
+      if (cost > limit)
+        return cost;
+    }
+  }
+
+  // Every byte of a mutated object is merged; count one term per word.
+  MemoryMap::iterator oa = a.addressSpace.objects.begin();
+  MemoryMap::iterator ob = b.addressSpace.objects.begin();
+  MemoryMap::iterator oae = a.addressSpace.objects.end();
+  MemoryMap::iterator obe = b.addressSpace.objects.end();
+  for (; oa != oae && ob != obe; ++oa, ++ob) {
+    if (oa->first != ob->first)
+      return limit + 1;
+    if (oa->second != ob->second) {
+      cost += (oa->first->size + 7) / 8;
+      if (cost > limit)
+        return cost;
+    }
+  }
+
+  return cost;
+}
+
+ExecutionState &DynamicMergingSearcher::selectState() {
+  ExecutionState &es = baseSearcher->selectState();
+
+  // As with the region merging searcher, states are only merged past the
+  // PHI nodes of a block, whose values depend on the incoming edge.
+  if (isa<PHINode>(es.pc->inst))
+    return es;
+
+  std::map<ExecutionState*, uint64_t>::iterator it = fingerprints.find(&es);
+  if (it == fingerprints.end())
+    return es;
+  std::map<uint64_t, std::set<ExecutionState*> >::iterator cit =
+    candidates.find(it->second);
+  if (cit == candidates.end() || cit->second.size() < 2)
+    return es;
+
+  std::vector<ExecutionState*> toMerge;
+  for (std::set<ExecutionState*>::iterator sit = cit->second.begin(),
+         sie = cit->second.end(); sit != sie; ++sit) {
+    ExecutionState *other = *sit;
+    if (other == &es || other->pc != es.pc)
+      continue;
+    if (estimateMergeCost(es, *other, maxCost) <= maxCost)
+      toMerge.push_back(other);
+  }
+
+  for (std::vector<ExecutionState*>::iterator mit = toMerge.begin(),
+         mie = toMerge.end(); mit != mie; ++mit) {
+    ExecutionState *other = *mit;
+    if (!es.merge(*other))
+      continue;
+
+    if (DebugLogMerge)
+      llvm::errs() << "\tmerged: " << &es << " with " << other << "\n";
+
+    // The merged state stays in the base searcher until its removal is
+    // reported; it is not selected before then as we return es.
+    unindex(other);
+    executor.terminateState(*other);
+  }
+
+  return es;
+}
+
+void DynamicMergingSearcher::update(ExecutionState *current,
+                                    const std::set<ExecutionState*> &addedStates,
+                                    const std::set<ExecutionState*> &removedStates) {
+  baseSearcher->update(current, addedStates, removedStates);
+
+  for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
+         ie = removedStates.end(); it != ie; ++it)
+    unindex(*it);
+
+  // Only the current and the added states have moved since the last update.
+  if (current && !removedStates.count(current))
+    index(current);
+  for (std::set<ExecutionState*>::const_iterator it = addedStates.begin(),
+         ie = addedStates.end(); it != ie; ++it)
+    index(*it);
+}
+
+///
+
 BatchingSearcher::BatchingSearcher(Searcher *_baseSearcher,
                                    double _timeBudget,
                                    unsigned _instructionBudget) 
@@ -27,6 +27,7 @@ namespace klee {
   template<class T> class DiscretePDF;
   class ExecutionState;
   class Executor;
+  class PTreeNode;
 
   class Searcher {
   public:
@@ -76,7 +77,9 @@ namespace klee {
       NURS_Depth,
       NURS_ICnt,
       NURS_CPICnt,
-      NURS_QC
+      NURS_QC,
+      RandomPath_MD2U,
+      RandomPath_QC
     };
   };
 
@@ -134,11 +137,40 @@ namespace klee {
     };
 
   private:
+    /// WeightInputs - The values the weight of a state was last computed
+    /// from. Fields which do not affect the weight type are left zero.
+    struct WeightInputs {
+      const void *location;
+      uint64_t count;
+      uint64_t coverageEpoch;
+      double queryCost;
+      unsigned instsSinceCovNew;
+
+      WeightInputs()
+        : location(0), count(0), coverageEpoch(0), queryCost(0.),
+          instsSinceCovNew(0) {}
+
+      bool operator==(const WeightInputs &b) const {
+        return location == b.location && count == b.count &&
+          coverageEpoch == b.coverageEpoch && queryCost == b.queryCost &&
+          instsSinceCovNew == b.instsSinceCovNew;
+      }
+    };
+
     DiscretePDF<ExecutionState*> *states;
     WeightType type;
     bool updateWeights;
+    /// The inputs of the current weight of every state.
+    std::map<ExecutionState*, WeightInputs> weightInputs;
+    /// States which may need reweighting before the next selection.
+    std::vector<ExecutionState*> pendingUpdates;
+    /// The number of covered instructions when the weights were last
+    /// brought up to date.
+    uint64_t coverageEpoch;
     
     double getWeight(ExecutionState*);
+    WeightInputs getWeightInputs(ExecutionState*);
+    void flushUpdates();
 
   public:
     WeightedRandomSearcher(WeightType type);
@@ -180,6 +212,44 @@ namespace klee {
     }
   };
 
+  /// WeightedRandomPathSearcher - Random path selection which, at each fork
+  /// of the process tree, descends into a subtree with probability
+  /// proportional to a weight derived from the subtree aggregates kept by
+  /// the process tree. A pick costs O(depth) and needs no PDF over all
+  /// states.
+  class WeightedRandomPathSearcher : public Searcher {
+  public:
+    enum WeightType {
+      MinDistToUncovered,
+      QueryCost
+    };
+
+  private:
+    Executor &executor;
+    WeightType type;
+
+    double getWeight(PTreeNode *n);
+    void updateLeaf(ExecutionState *es);
+
+  public:
+    WeightedRandomPathSearcher(Executor &_executor, WeightType _type);
+    ~WeightedRandomPathSearcher();
+
+    ExecutionState &selectState();
+    void update(ExecutionState *current,
+                const std::set<ExecutionState*> &addedStates,
+                const std::set<ExecutionState*> &removedStates);
+    bool empty();
+    void printName(llvm::raw_ostream &os) {
+      os << "WeightedRandomPathSearcher::";
+      switch(type) {
+      case MinDistToUncovered : os << "MinDistToUncovered\n"; return;
+      case QueryCost          : os << "QueryCost\n"; return;
+      default                 : os << "<unknown type>\n"; return;
+      }
+    }
+  };
+
   class MergingSearcher : public Searcher {
     Executor &executor;
     std::set<ExecutionState*> statesAtMerge;
@@ -203,6 +273,111 @@ namespace klee {
     }
   };
 
+  /// RegionMergingSearcher - Merge states automatically at the exit of
+  /// acyclic single-entry regions. When a state reaches a conditional
+  /// branch heading such a region, the states forked from it inside the
+  /// region are held at the region exit (the immediate post-dominator of
+  /// the branch) and merged, with ITE-valued registers and memory, once
+  /// none of them is still running in the region.
+  class RegionMergingSearcher : public Searcher {
+    /// A region a state is executing in. States forked inside the region
+    /// share its identifier.
+    struct RegionEntry {
+      unsigned id;
+      llvm::Instruction *mergePoint;
+      unsigned depth;
+
+      RegionEntry(unsigned _id, llvm::Instruction *_mergePoint,
+                  unsigned _depth)
+        : id(_id), mergePoint(_mergePoint), depth(_depth) {}
+    };
+
+    Executor &executor;
+    Searcher *baseSearcher;
+    unsigned maxBlocks;
+    unsigned nextRegionId;
+    std::set<llvm::Function*> analyzedFunctions;
+    /// The merge point of each terminator heading a mergeable region.
+    std::map<llvm::Instruction*, llvm::Instruction*> mergePoints;
+    /// The regions each state is executing in, innermost last.
+    std::map<ExecutionState*, std::vector<RegionEntry> > stateRegions;
+    /// The number of states of each region not yet at its merge point.
+    std::map<unsigned, unsigned> runningStates;
+    /// The states held at the merge point of each region.
+    std::map<unsigned, std::vector<ExecutionState*> > heldStates;
+    /// The region each held state is waiting for.
+    std::map<ExecutionState*, unsigned> held;
+    /// States merged into others, awaiting their removal.
+    std::set<ExecutionState*> mergedStates;
+    /// Regions whose states have all arrived at the merge point.
+    std::vector<unsigned> readyRegions;
+
+    void analyzeFunction(llvm::Function *f);
+    llvm::Instruction *getMergePoint(llvm::Instruction *i);
+    void leaveRegion(unsigned id);
+    void releaseRegion(unsigned id);
+
+  public:
+    RegionMergingSearcher(Executor &executor, Searcher *baseSearcher,
+                          unsigned maxBlocks);
+    ~RegionMergingSearcher();
+
+    ExecutionState &selectState();
+    void update(ExecutionState *current,
+                const std::set<ExecutionState*> &addedStates,
+                const std::set<ExecutionState*> &removedStates);
+    bool empty() { return baseSearcher->empty() && held.empty(); }
+    void printName(llvm::raw_ostream &os) {
+      os << "<RegionMergingSearcher> containing searcher: ";
+      baseSearcher->printName(os);
+      os << "</RegionMergingSearcher>\n";
+    }
+  };
+
+  /// DynamicMergingSearcher - Opportunistically merge the selected state
+  /// with the states waiting at the same pc. Candidates are found through
+  /// their merge fingerprints, and a merge is only attempted when the
+  /// estimated cost of the merged state stays within a budget.
+  class DynamicMergingSearcher : public Searcher {
+    Executor &executor;
+    Searcher *baseSearcher;
+    unsigned maxCost;
+    std::map<ExecutionState*, uint64_t> fingerprints;
+    std::map<uint64_t, std::set<ExecutionState*> > candidates;
+
+    void index(ExecutionState *es);
+    void unindex(ExecutionState *es);
+
+  public:
+    DynamicMergingSearcher(Executor &executor, Searcher *baseSearcher,
+                           unsigned maxCost);
+    ~DynamicMergingSearcher();
+
+    /// Estimate the cost of merging two states with equal fingerprints
+    /// from the size of the disjunction and the number of values that
+    /// become if-then-else expressions. Values concrete in both states
+    /// weigh more, as the branches depending on them will need the
+    /// solver once merged.
+    ///
+    /// \return The estimated cost, or a value greater than \arg limit if
+    /// it exceeds \arg limit.
+    static unsigned estimateMergeCost(const ExecutionState &a,
+                                      const ExecutionState &b,
+                                      unsigned limit);
+
+    ExecutionState &selectState();
+    void update(ExecutionState *current,
+                const std::set<ExecutionState*> &addedStates,
+                const std::set<ExecutionState*> &removedStates);
+    bool empty() { return baseSearcher->empty(); }
+    void printName(llvm::raw_ostream &os) {
+      os << "<DynamicMergingSearcher> maxCost: " << maxCost
+         << ", containing searcher: ";
+      baseSearcher->printName(os);
+      os << "</DynamicMergingSearcher>\n";
+    }
+  };
+
   class BumpMergingSearcher : public Searcher {
     Executor &executor;
     std::map<llvm::Instruction*, ExecutionState*> statesAtMerge;
@@ -0,0 +1,74 @@
+//===-- SearcherTrace.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SearcherTrace.h"
+
+#include "klee/ExecutionState.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+using namespace klee;
+
+SearcherTraceWriter::SearcherTraceWriter(llvm::raw_ostream *_os)
+  : os(_os), nextId(1), stepState(0), steps(0), stepDepth(0),
+    stepQueryCost(0.) {}
+
+SearcherTraceWriter::~SearcherTraceWriter() {
+  flushSteps();
+  delete os;
+}
+
+unsigned SearcherTraceWriter::getId(const ExecutionState *es) {
+  unsigned &id = ids[es];
+  if (!id)
+    id = nextId++;
+  return id;
+}
+
+void SearcherTraceWriter::flushSteps() {
+  if (!steps)
+    return;
+  *os << "s " << stepState << " " << steps << " " << stepDepth << " "
+      << stepQueryCost << "\n";
+  steps = 0;
+}
+
+void SearcherTraceWriter::update(ExecutionState *current,
+                                 const std::set<ExecutionState*> &addedStates,
+                                 const std::set<ExecutionState*> &removedStates) {
+  unsigned currentId = 0;
+  if (current) {
+    currentId = getId(current);
+    // Consecutive steps of a state which do not change what the searcher
+    // sees are written as one run.
+    if (steps && (stepState != currentId || stepDepth != current->depth ||
+                  stepQueryCost != current->queryCost))
+      flushSteps();
+    stepState = currentId;
+    stepDepth = current->depth;
+    stepQueryCost = current->queryCost;
+    ++steps;
+  }
+
+  if (addedStates.empty() && removedStates.empty())
+    return;
+
+  flushSteps();
+  for (std::set<ExecutionState*>::const_iterator it = addedStates.begin(),
+         ie = addedStates.end(); it != ie; ++it)
+    *os << "a " << getId(*it) << " " << currentId << "\n";
+  for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
+         ie = removedStates.end(); it != ie; ++it) {
+    std::map<const ExecutionState*, unsigned>::iterator id = ids.find(*it);
+    if (id == ids.end())
+      continue;
+    *os << "r " << id->second << "\n";
+    ids.erase(id);
+  }
+}
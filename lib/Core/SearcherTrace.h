@@ -0,0 +1,69 @@
+//===-- SearcherTrace.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SEARCHERTRACE_H
+#define KLEE_SEARCHERTRACE_H
+
+#include <map>
+#include <set>
+
+#include <stdint.h>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace klee {
+  class ExecutionState;
+
+  /// SearcherTraceWriter - Records the updates a searcher receives during
+  /// a run, so searchers can be benchmarked against them without running
+  /// KLEE (see klee-searcher-bench).
+  ///
+  /// The trace is text, one event per line, with states numbered from 1:
+  ///
+  ///   s <state> <steps> <depth> <query cost>
+  ///     \arg state executed \arg steps consecutive instructions, after
+  ///     which it had the given depth and query cost.
+  ///   a <state> <parent>
+  ///     \arg state was added, forked from \arg parent (0 if the state was
+  ///     not forked from a live state).
+  ///   r <state>
+  ///     \arg state was removed.
+  ///
+  /// The additions and removals following an 's' line are passed to the
+  /// searcher together, with the stepped state as the current state.
+  /// Additions are attributed to the stepped state even when another state
+  /// forked them.
+  class SearcherTraceWriter {
+    llvm::raw_ostream *os;
+    std::map<const ExecutionState*, unsigned> ids;
+    unsigned nextId;
+
+    /// The run of steps not written yet.
+    unsigned stepState;
+    uint64_t steps;
+    unsigned stepDepth;
+    double stepQueryCost;
+
+    unsigned getId(const ExecutionState *es);
+    void flushSteps();
+
+  public:
+    /// Write the trace to \arg os, which is owned by the writer.
+    explicit SearcherTraceWriter(llvm::raw_ostream *os);
+    ~SearcherTraceWriter();
+
+    void update(ExecutionState *current,
+                const std::set<ExecutionState*> &addedStates,
+                const std::set<ExecutionState*> &removedStates);
+  };
+}
+
+#endif
@@ -61,17 +61,30 @@ KTestObject *SeedInfo::getNextInput(const MemoryObject *mo,
 void SeedInfo::patchSeed(const ExecutionState &state, 
                          ref<Expr> condition,
                          TimingSolver *solver) {
-  std::vector< ref<Expr> > required(state.constraints.begin(),
-                                    state.constraints.end());
-  ExecutionState tmp(required);
-  tmp.addConstraint(condition);
+  patchSeeds(state, condition, std::vector<SeedInfo*>(1, this), solver);
+}
+
+void SeedInfo::patchSeeds(const ExecutionState &state,
+                          ref<Expr> condition,
+                          const std::vector<SeedInfo*> &seeds,
+                          TimingSolver *solver) {
+  // The path constraints with the condition added (and the constraints
+  // rewritten by it) are the starting point of every seed.
+  std::vector< ref<Expr> > required;
+  {
+    std::vector< ref<Expr> > constraints(state.constraints.begin(),
+                                         state.constraints.end());
+    ExecutionState tmp(constraints);
+    tmp.addConstraint(condition);
+    required.assign(tmp.constraints.begin(), tmp.constraints.end());
+  }
 
   // Try and patch direct reads first, this is likely to resolve the
   // problem quickly and avoids long traversal of all seed
   // values. There are other smart ways to do this, the nicest is if
   // we got a minimal counterexample from STP, in which case we would
   // just inject those values back into the seed.
-  std::set< std::pair<const Array*, unsigned> > directReads;
+  reads_ty directReads;
   std::vector< ref<ReadExpr> > reads;
   findReads(condition, false, reads);
   for (std::vector< ref<ReadExpr> >::iterator it = reads.begin(), 
@@ -82,8 +95,18 @@ void SeedInfo::patchSeed(const ExecutionState &state,
                                         (unsigned) CE->getZExtValue(32)));
     }
   }
-  
-  for (std::set< std::pair<const Array*, unsigned> >::iterator
+
+  for (std::vector<SeedInfo*>::const_iterator it = seeds.begin(),
+         ie = seeds.end(); it != ie; ++it)
+    (*it)->patch(state, condition, required, directReads, solver);
+}
+
+void SeedInfo::patch(const ExecutionState &state, ref<Expr> condition,
+                     const std::vector< ref<Expr> > &required,
+                     const reads_ty &directReads, TimingSolver *solver) {
+  ExecutionState tmp(required);
+
+  for (reads_ty::const_iterator
          it = directReads.begin(), ie = directReads.end(); it != ie; ++it) {
     const Array *array = it->first;
     unsigned i = it->second;
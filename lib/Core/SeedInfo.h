@@ -12,6 +12,10 @@
 
 #include "klee/util/Assignment.h"
 
+#include <map>
+#include <set>
+#include <vector>
+
 extern "C" {
   struct KTest;
   struct KTestObject;
@@ -21,7 +25,18 @@ namespace klee {
   class ExecutionState;
   class TimingSolver;
 
+  /// SeedValueCache - Values chosen by the solver for expressions which
+  /// are not constant under a seed, shared by the seeds under which an
+  /// expression evaluates alike.
+  typedef std::map< ref<Expr>, ref<ConstantExpr> > SeedValueCache;
+
   class SeedInfo {
+    typedef std::set< std::pair<const Array*, unsigned> > reads_ty;
+
+    void patch(const ExecutionState &state, ref<Expr> condition,
+               const std::vector< ref<Expr> > &required,
+               const reads_ty &directReads, TimingSolver *solver);
+
   public:
     Assignment assignment;
     KTest *input;
@@ -42,6 +57,13 @@ namespace klee {
     void patchSeed(const ExecutionState &state, 
                    ref<Expr> condition,
                    TimingSolver *solver);
+
+    /// Patch each of \arg seeds as patchSeed does, sharing the work which
+    /// does not depend on the seed values.
+    static void patchSeeds(const ExecutionState &state,
+                           ref<Expr> condition,
+                           const std::vector<SeedInfo*> &seeds,
+                           TimingSolver *solver);
   };
 }
 
@@ -25,8 +25,10 @@
 #include "klee/CommandLine.h"
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #else
+#include "llvm/Instructions.h"
 #include "llvm/Module.h"
 #endif
 #include "llvm/ADT/Twine.h"
@@ -42,6 +44,16 @@ namespace {
             cl::init(false),
             cl::desc("Prefer creation of POSIX inputs (command-line arguments, files, etc.) with human readable bytes. "
                      "Note: option is expensive when creating lots of tests (default=false)"));
+
+  cl::opt<bool>
+  AccelerateMemoryIntrinsics("accelerate-memory-intrinsics",
+                             cl::init(false),
+                             cl::desc("Execute calls to memcpy, memmove, mempcpy and memset with concrete pointers and sizes as bulk memory operations instead of interpreting their loops.  Only use with the runtime's implementations of these functions.  (default=off)"));
+
+  cl::opt<bool>
+  NativeMemoryBuiltins("native-memory-builtins",
+                       cl::init(false),
+                       cl::desc("Like --accelerate-memory-intrinsics, and also execute calls to memcmp and strlen with concrete pointers and sizes natively, building expressions for symbolic bytes instead of interpreting their loops.  (default=off)"));
 }
 
 
@@ -130,6 +142,23 @@ static SpecialFunctionHandler::HandlerInfo handlerInfo[] = {
 #undef add  
 };
 
+struct BuiltinInfo {
+  const char *name;
+  SpecialFunctionHandler::BuiltinHandler handler;
+  /// Whether --accelerate-memory-intrinsics enables it, rather than only
+  /// --native-memory-builtins.
+  bool isMemoryIntrinsic;
+};
+
+static BuiltinInfo builtinInfo[] = {
+  { "memcmp", &SpecialFunctionHandler::handleMemcmp, false },
+  { "memcpy", &SpecialFunctionHandler::handleMemcpy, true },
+  { "memmove", &SpecialFunctionHandler::handleMemcpy, true },
+  { "mempcpy", &SpecialFunctionHandler::handleMempcpy, true },
+  { "memset", &SpecialFunctionHandler::handleMemset, true },
+  { "strlen", &SpecialFunctionHandler::handleStrlen, false },
+};
+
 SpecialFunctionHandler::const_iterator SpecialFunctionHandler::begin() {
   return SpecialFunctionHandler::const_iterator(handlerInfo);
 }
@@ -199,6 +228,17 @@ void SpecialFunctionHandler::bind() {
     if (f && (!hi.doNotOverride || f->isDeclaration()))
       handlers[f] = std::make_pair(hi.handler, hi.hasReturnValue);
   }
+
+  if (AccelerateMemoryIntrinsics || NativeMemoryBuiltins) {
+    for (unsigned i = 0; i != sizeof(builtinInfo) / sizeof(builtinInfo[0]);
+         ++i) {
+      BuiltinInfo &bi = builtinInfo[i];
+      if (!NativeMemoryBuiltins && !bi.isMemoryIntrinsic)
+        continue;
+      if (Function *f = executor.kmodule->module->getFunction(bi.name))
+        builtins[f] = bi.handler;
+    }
+  }
 }
 
 
@@ -223,6 +263,18 @@ bool SpecialFunctionHandler::handle(ExecutionState &state,
   }
 }
 
+bool SpecialFunctionHandler::handleBuiltin(ExecutionState &state,
+                                           Function *f,
+                                           KInstruction *target,
+                                           std::vector< ref<Expr> > &arguments) {
+  if (builtins.empty() || !isa<CallInst>(target->inst))
+    return false;
+  builtins_ty::iterator it = builtins.find(f);
+  if (it == builtins.end())
+    return false;
+  return (this->*(it->second))(state, target, arguments);
+}
+
 /****/
 
 // reads a concrete string from memory
@@ -764,3 +816,182 @@ void SpecialFunctionHandler::handleDivRemOverflow(ExecutionState &state,
                                  "overflow on division or remainder",
                                  "overflow.err");
 }
+
+/* Builtins */
+
+/// Find the object holding the \arg len bytes at \arg address, and the
+/// offset of \arg address in it. Invalid accesses are left to the
+/// interpreted loops, which report them at the faulting byte.
+static bool resolveRange(ExecutionState &state, ref<Expr> address,
+                         uint64_t len, ObjectPair &op, unsigned &offset) {
+  klee::ConstantExpr *CE = dyn_cast<klee::ConstantExpr>(address);
+  if (!CE || !state.addressSpace.resolveOne(CE, op))
+    return false;
+  uint64_t delta = CE->getZExtValue() - op.first->address;
+  if (delta > op.first->size || len > op.first->size - delta)
+    return false;
+  offset = delta;
+  return true;
+}
+
+bool SpecialFunctionHandler::copyMemory(ExecutionState &state,
+                                        std::vector<ref<Expr> > &arguments) {
+  ConstantExpr *len = dyn_cast<ConstantExpr>(arguments[2]);
+  if (!len)
+    return false;
+  uint64_t n = len->getZExtValue();
+  if (!n)
+    return isa<ConstantExpr>(arguments[0]);
+
+  ObjectPair destOp, srcOp;
+  unsigned destOffset, srcOffset;
+  if (!resolveRange(state, arguments[0], n, destOp, destOffset) ||
+      destOp.second->readOnly ||
+      !resolveRange(state, arguments[1], n, srcOp, srcOffset))
+    return false;
+
+  ObjectState *wos = state.addressSpace.getWriteable(destOp.first,
+                                                     destOp.second);
+  const ObjectState *ros = srcOp.first == destOp.first ? wos : srcOp.second;
+  wos->copy(destOffset, *ros, srcOffset, n);
+  return true;
+}
+
+bool SpecialFunctionHandler::handleMemcpy(ExecutionState &state,
+                                          KInstruction *target,
+                                          std::vector<ref<Expr> > &arguments) {
+  if (arguments.size() != 3 || !copyMemory(state, arguments))
+    return false;
+  executor.bindLocal(target, state, arguments[0]);
+  return true;
+}
+
+bool SpecialFunctionHandler::handleMempcpy(ExecutionState &state,
+                                           KInstruction *target,
+                                           std::vector<ref<Expr> > &arguments) {
+  if (arguments.size() != 3 || !copyMemory(state, arguments))
+    return false;
+  executor.bindLocal(target, state,
+                     AddExpr::create(arguments[0],
+                                     ZExtExpr::create(arguments[2],
+                                                      arguments[0]->getWidth())));
+  return true;
+}
+
+bool SpecialFunctionHandler::handleMemset(ExecutionState &state,
+                                          KInstruction *target,
+                                          std::vector<ref<Expr> > &arguments) {
+  if (arguments.size() != 3)
+    return false;
+  ConstantExpr *len = dyn_cast<ConstantExpr>(arguments[2]);
+  if (!len || !isa<ConstantExpr>(arguments[0]))
+    return false;
+
+  if (uint64_t n = len->getZExtValue()) {
+    ObjectPair op;
+    unsigned offset;
+    if (!resolveRange(state, arguments[0], n, op, offset) ||
+        op.second->readOnly)
+      return false;
+
+    ObjectState *wos = state.addressSpace.getWriteable(op.first, op.second);
+    wos->fill(offset, ExtractExpr::create(arguments[1], 0, Expr::Int8), n);
+  }
+
+  executor.bindLocal(target, state, arguments[0]);
+  return true;
+}
+
+bool SpecialFunctionHandler::handleMemcmp(ExecutionState &state,
+                                          KInstruction *target,
+                                          std::vector<ref<Expr> > &arguments) {
+  if (arguments.size() != 3)
+    return false;
+  ConstantExpr *len = dyn_cast<ConstantExpr>(arguments[2]);
+  if (!len || !isa<ConstantExpr>(arguments[0]) ||
+      !isa<ConstantExpr>(arguments[1]))
+    return false;
+
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+  ref<Expr> result = ConstantExpr::create(0, width);
+
+  if (uint64_t n = len->getZExtValue()) {
+    ObjectPair op1, op2;
+    unsigned offset1, offset2;
+    if (!resolveRange(state, arguments[0], n, op1, offset1) ||
+        !resolveRange(state, arguments[1], n, op2, offset2))
+      return false;
+
+    // Only the byte pairs up to the first concrete difference which may
+    // differ decide the result, the rest is skipped.
+    std::vector< std::pair< ref<Expr>, ref<Expr> > > pairs;
+    for (uint64_t i = 0; i != n; ++i) {
+      ref<Expr> a = op1.second->read8(offset1 + i);
+      ref<Expr> b = op2.second->read8(offset2 + i);
+      ConstantExpr *ca = dyn_cast<ConstantExpr>(a);
+      ConstantExpr *cb = dyn_cast<ConstantExpr>(b);
+      if (ca && cb) {
+        if (ca->getZExtValue() == cb->getZExtValue())
+          continue;
+        result = SubExpr::create(ZExtExpr::create(a, width),
+                                 ZExtExpr::create(b, width));
+        break;
+      }
+      pairs.push_back(std::make_pair(a, b));
+    }
+
+    for (unsigned i = pairs.size(); i != 0; --i) {
+      ref<Expr> a = pairs[i - 1].first, b = pairs[i - 1].second;
+      result = SelectExpr::create(NeExpr::create(a, b),
+                                  SubExpr::create(ZExtExpr::create(a, width),
+                                                  ZExtExpr::create(b, width)),
+                                  result);
+    }
+  }
+
+  executor.bindLocal(target, state, result);
+  return true;
+}
+
+bool SpecialFunctionHandler::handleStrlen(ExecutionState &state,
+                                          KInstruction *target,
+                                          std::vector<ref<Expr> > &arguments) {
+  ObjectPair op;
+  unsigned offset;
+  if (arguments.size() != 1 ||
+      !resolveRange(state, arguments[0], 1, op, offset))
+    return false;
+
+  // Find the first concrete terminator, noting the symbolic bytes before
+  // it which may end the string earlier.
+  std::vector< std::pair<unsigned, ref<Expr> > > candidates;
+  unsigned end = offset;
+  for (; end != op.first->size; ++end) {
+    ref<Expr> c = op.second->read8(end);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(c)) {
+      if (CE->isZero())
+        break;
+    } else {
+      candidates.push_back(std::make_pair(end, c));
+    }
+  }
+
+  // The interpreted loop would run past the object.
+  if (end == op.first->size)
+    return false;
+
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+  ref<Expr> result = ConstantExpr::create(end - offset, width);
+  for (unsigned i = candidates.size(); i != 0; --i) {
+    ref<Expr> c = candidates[i - 1].second;
+    result = SelectExpr::create(EqExpr::create(c,
+                                               ConstantExpr::create(0,
+                                                                    Expr::Int8)),
+                                ConstantExpr::create(candidates[i - 1].first -
+                                                     offset, width),
+                                result);
+  }
+
+  executor.bindLocal(target, state, result);
+  return true;
+}
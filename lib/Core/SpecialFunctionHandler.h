@@ -35,7 +35,15 @@ namespace klee {
     typedef std::map<const llvm::Function*, 
                      std::pair<Handler,bool> > handlers_ty;
 
+    /// A builtin handler returns false, leaving the state untouched, when
+    /// the call must be interpreted instead.
+    typedef bool (SpecialFunctionHandler::*BuiltinHandler)(
+      ExecutionState &state, KInstruction *target,
+      std::vector<ref<Expr> > &arguments);
+    typedef std::map<const llvm::Function*, BuiltinHandler> builtins_ty;
+
     handlers_ty handlers;
+    builtins_ty builtins;
     class Executor &executor;
 
     struct HandlerInfo {
@@ -88,9 +96,21 @@ namespace klee {
                 KInstruction *target,
                 std::vector< ref<Expr> > &arguments);
 
+    /// Run the call to \arg f natively if it is a memory builtin and its
+    /// arguments allow it. Unlike special functions, builtins keep their
+    /// bodies, which are interpreted when this returns false.
+    bool handleBuiltin(ExecutionState &state,
+                       llvm::Function *f,
+                       KInstruction *target,
+                       std::vector< ref<Expr> > &arguments);
+
     /* Convenience routines */
 
     std::string readStringAtAddress(ExecutionState &state, ref<Expr> address);
+
+    /// Copy the bytes of a memcpy-like call in bulk, returning false if
+    /// the call must be interpreted.
+    bool copyMemory(ExecutionState &state, std::vector< ref<Expr> > &arguments);
     
     /* Handlers */
 
@@ -138,6 +158,18 @@ namespace klee {
     HANDLER(handleSubOverflow);
     HANDLER(handleDivRemOverflow);
 #undef HANDLER
+
+    /* Builtins */
+
+#define BUILTIN(name) bool name(ExecutionState &state, \
+                                KInstruction *target, \
+                                std::vector< ref<Expr> > &arguments)
+    BUILTIN(handleMemcmp);
+    BUILTIN(handleMemcpy);
+    BUILTIN(handleMempcpy);
+    BUILTIN(handleMemset);
+    BUILTIN(handleStrlen);
+#undef BUILTIN
   };
 } // End klee namespace
 
@@ -0,0 +1,520 @@
+//===-- StateSwapper.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StateSwapper.h"
+
+#include "Common.h"
+#include "Memory.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Expr.h"
+#include "klee/Internal/Module/Cell.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/util/BitArray.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+  /// The entries of a spill record. Expressions and update nodes are
+  /// numbered in the order they are written and always precede their users.
+  enum SpillTag {
+    ExprTag,
+    UpdateNodeTag,
+    ConstraintTag,
+    LocalTag,
+    ObjectTag,
+    EndTag
+  };
+
+  const uint32_t NoId = ~0U;
+
+  template<class T>
+  void append(std::string &record, const T &value) {
+    record.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  class SpillWriter {
+    std::vector<char> &buffer;
+    std::map<const Expr*, uint32_t> exprIds;
+    std::map<const UpdateNode*, uint32_t> nodeIds;
+    /// The ids of the records written so far, by contents. Equal nodes
+    /// reached through different pointers share a record, and are
+    /// therefore restored as a single node.
+    std::map<std::string, uint32_t> exprRecords, nodeRecords;
+
+    uint32_t writeRecord(std::map<std::string, uint32_t> &records,
+                         const std::string &record);
+
+  public:
+    explicit SpillWriter(std::vector<char> &_buffer) : buffer(_buffer) {}
+
+    void writeRaw(const void *data, size_t size) {
+      const char *p = static_cast<const char*>(data);
+      buffer.insert(buffer.end(), p, p + size);
+    }
+
+    template<class T>
+    void write(const T &value) { writeRaw(&value, sizeof(value)); }
+
+    void writeBits(BitArray *bits, unsigned size);
+    uint32_t writeUpdates(const UpdateNode *head);
+    uint32_t writeExpr(const ref<Expr> &e);
+  };
+
+  class SpillReader {
+    const char *pos, *end;
+    /// The expressions read so far, by id, so that every use of a record
+    /// restores the same node.
+    std::vector< ref<Expr> > exprs;
+    /// Holds each update node read so far as the head of a list, by id.
+    std::vector<UpdateList> nodes;
+
+  public:
+    SpillReader(const std::vector<char> &buffer)
+      : pos(&buffer[0]), end(&buffer[0] + buffer.size()) {}
+
+    void readRaw(void *data, size_t size) {
+      assert(pos + size <= end && "truncated spill record");
+      memcpy(data, pos, size);
+      pos += size;
+    }
+
+    template<class T>
+    T read() { T value; readRaw(&value, sizeof(value)); return value; }
+
+    BitArray *readBits(unsigned size);
+    const UpdateNode *getUpdates(uint32_t id) {
+      return id == NoId ? 0 : nodes[id].head;
+    }
+    ref<Expr> getExpr(uint32_t id) {
+      return id == NoId ? ref<Expr>() : exprs[id];
+    }
+
+    void readUpdateNode();
+    void readExpr();
+  };
+}
+
+void SpillWriter::writeBits(BitArray *bits, unsigned size) {
+  write<uint8_t>(bits != 0);
+  if (!bits)
+    return;
+  for (unsigned i = 0; i < size; i += 8) {
+    uint8_t byte = 0;
+    for (unsigned j = 0; j != 8 && i + j < size; ++j)
+      byte |= bits->get(i + j) << j;
+    write(byte);
+  }
+}
+
+uint32_t SpillWriter::writeRecord(std::map<std::string, uint32_t> &records,
+                                  const std::string &record) {
+  std::map<std::string, uint32_t>::iterator it = records.find(record);
+  if (it != records.end())
+    return it->second;
+  writeRaw(record.data(), record.size());
+  uint32_t id = records.size();
+  records[record] = id;
+  return id;
+}
+
+uint32_t SpillWriter::writeUpdates(const UpdateNode *head) {
+  // Write the nodes not seen yet, oldest first, without recursing down
+  // long update lists.
+  std::vector<const UpdateNode*> pending;
+  for (const UpdateNode *un = head; un && !nodeIds.count(un); un = un->next)
+    pending.push_back(un);
+
+  for (std::vector<const UpdateNode*>::reverse_iterator
+         it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+    const UpdateNode *un = *it;
+    uint32_t next = un->next ? nodeIds[un->next] : NoId;
+    uint32_t index = writeExpr(un->index);
+    uint32_t value = writeExpr(un->value);
+    std::string record;
+    append<uint8_t>(record, UpdateNodeTag);
+    append(record, next);
+    append(record, index);
+    append(record, value);
+    nodeIds[un] = writeRecord(nodeRecords, record);
+  }
+
+  return head ? nodeIds[head] : NoId;
+}
+
+uint32_t SpillWriter::writeExpr(const ref<Expr> &e) {
+  std::map<const Expr*, uint32_t>::iterator it = exprIds.find(e.get());
+  if (it != exprIds.end())
+    return it->second;
+
+  std::string record;
+  if (ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+    const APInt &value = ce->getAPValue();
+    append<uint8_t>(record, ExprTag);
+    append<uint8_t>(record, Expr::Constant);
+    append<uint32_t>(record, value.getBitWidth());
+    append<uint32_t>(record, value.getNumWords());
+    record.append(reinterpret_cast<const char*>(value.getRawData()),
+                  value.getNumWords() * sizeof(uint64_t));
+  } else if (ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    uint32_t head = writeUpdates(re->updates.head);
+    uint32_t index = writeExpr(re->index);
+    append<uint8_t>(record, ExprTag);
+    append<uint8_t>(record, Expr::Read);
+    append<uint64_t>(record, (uintptr_t) re->updates.root);
+    append(record, head);
+    append(record, index);
+  } else {
+    unsigned numKids = e->getNumKids();
+    std::vector<uint32_t> kids(numKids);
+    for (unsigned i = 0; i != numKids; ++i)
+      kids[i] = writeExpr(e->getKid(i));
+
+    append<uint8_t>(record, ExprTag);
+    append<uint8_t>(record, e->getKind());
+    append<uint8_t>(record, numKids);
+    for (unsigned i = 0; i != numKids; ++i)
+      append(record, kids[i]);
+    if (ExtractExpr *ee = dyn_cast<ExtractExpr>(e)) {
+      append<uint32_t>(record, ee->offset);
+      append<uint32_t>(record, ee->width);
+    } else if (isa<CastExpr>(e)) {
+      append<uint32_t>(record, e->getWidth());
+    }
+  }
+
+  uint32_t id = writeRecord(exprRecords, record);
+  exprIds[e.get()] = id;
+  return id;
+}
+
+BitArray *SpillReader::readBits(unsigned size) {
+  if (!read<uint8_t>())
+    return 0;
+  BitArray *bits = new BitArray(size);
+  for (unsigned i = 0; i < size; i += 8) {
+    uint8_t byte = read<uint8_t>();
+    for (unsigned j = 0; j != 8 && i + j < size; ++j)
+      bits->set(i + j, (byte >> j) & 1);
+  }
+  return bits;
+}
+
+void SpillReader::readUpdateNode() {
+  const UpdateNode *next = getUpdates(read<uint32_t>());
+  ref<Expr> index = getExpr(read<uint32_t>());
+  ref<Expr> value = getExpr(read<uint32_t>());
+  nodes.push_back(UpdateList(0, new UpdateNode(next, index, value)));
+}
+
+void SpillReader::readExpr() {
+  Expr::Kind kind = (Expr::Kind) read<uint8_t>();
+
+  if (kind == Expr::Constant) {
+    unsigned width = read<uint32_t>();
+    std::vector<uint64_t> words(read<uint32_t>());
+    readRaw(&words[0], words.size() * sizeof(uint64_t));
+    exprs.push_back(ConstantExpr::alloc(APInt(width, words.size(),
+                                              &words[0])));
+    return;
+  }
+
+  if (kind == Expr::Read) {
+    const Array *root = (const Array*) (uintptr_t) read<uint64_t>();
+    const UpdateNode *head = getUpdates(read<uint32_t>());
+    ref<Expr> index = getExpr(read<uint32_t>());
+    exprs.push_back(ReadExpr::alloc(UpdateList(root, head), index));
+    return;
+  }
+
+  unsigned numKids = read<uint8_t>();
+  ref<Expr> kids[3];
+  assert(numKids <= 3 && "invalid spilled expression");
+  for (unsigned i = 0; i != numKids; ++i)
+    kids[i] = getExpr(read<uint32_t>());
+
+  ref<Expr> e;
+  switch (kind) {
+  case Expr::NotOptimized: e = NotOptimizedExpr::alloc(kids[0]); break;
+  case Expr::Not: e = NotExpr::alloc(kids[0]); break;
+  case Expr::Select: e = SelectExpr::alloc(kids[0], kids[1], kids[2]); break;
+  case Expr::Concat: e = ConcatExpr::alloc(kids[0], kids[1]); break;
+  case Expr::Extract: {
+    unsigned offset = read<uint32_t>();
+    unsigned width = read<uint32_t>();
+    e = ExtractExpr::alloc(kids[0], offset, width);
+    break;
+  }
+
+#define CAST_EXPR_CASE(T)                                       \
+  case Expr::T: e = T ## Expr::alloc(kids[0], read<uint32_t>()); break;
+#define BINARY_EXPR_CASE(T)                                     \
+  case Expr::T: e = T ## Expr::alloc(kids[0], kids[1]); break;
+
+  CAST_EXPR_CASE(ZExt)
+  CAST_EXPR_CASE(SExt)
+
+  BINARY_EXPR_CASE(Add)
+  BINARY_EXPR_CASE(Sub)
+  BINARY_EXPR_CASE(Mul)
+  BINARY_EXPR_CASE(UDiv)
+  BINARY_EXPR_CASE(SDiv)
+  BINARY_EXPR_CASE(URem)
+  BINARY_EXPR_CASE(SRem)
+  BINARY_EXPR_CASE(And)
+  BINARY_EXPR_CASE(Or)
+  BINARY_EXPR_CASE(Xor)
+  BINARY_EXPR_CASE(Shl)
+  BINARY_EXPR_CASE(LShr)
+  BINARY_EXPR_CASE(AShr)
+
+  BINARY_EXPR_CASE(Eq)
+  BINARY_EXPR_CASE(Ne)
+  BINARY_EXPR_CASE(Ult)
+  BINARY_EXPR_CASE(Ule)
+  BINARY_EXPR_CASE(Ugt)
+  BINARY_EXPR_CASE(Uge)
+  BINARY_EXPR_CASE(Slt)
+  BINARY_EXPR_CASE(Sle)
+  BINARY_EXPR_CASE(Sgt)
+  BINARY_EXPR_CASE(Sge)
+
+#undef CAST_EXPR_CASE
+#undef BINARY_EXPR_CASE
+
+  default:
+    assert(0 && "invalid spilled expression kind");
+  }
+
+  exprs.push_back(e);
+}
+
+/***/
+
+StateSwapper::StateSwapper(const std::string &_path)
+  : path(_path), fileSize(0) {
+  file.open(path.c_str(), std::ios::in | std::ios::out | std::ios::trunc |
+                          std::ios::binary);
+  if (!file)
+    klee_error("unable to open state spill file: %s", path.c_str());
+}
+
+StateSwapper::~StateSwapper() {
+  for (std::map<ExecutionState*, SuspendedState>::iterator
+         it = suspended.begin(), ie = suspended.end(); it != ie; ++it)
+    release(it->second);
+  file.close();
+  std::remove(path.c_str());
+}
+
+void StateSwapper::release(SuspendedState &ss) {
+  for (std::vector<const MemoryObject*>::iterator it = ss.spilled.begin(),
+         ie = ss.spilled.end(); it != ie; ++it) {
+    const MemoryObject *mo = *it;
+    assert(mo->refCount > 0);
+    if (--mo->refCount == 0)
+      delete mo;
+  }
+  ss.spilled.clear();
+  ss.shared.clear();
+}
+
+void StateSwapper::suspend(ExecutionState &state) {
+  assert(!state.suspended && "state already suspended");
+
+  std::vector<char> buffer;
+  SpillWriter writer(buffer);
+  SuspendedState &ss = suspended[&state];
+
+  for (ConstraintManager::constraint_iterator it = state.constraints.begin(),
+         ie = state.constraints.end(); it != ie; ++it) {
+    uint32_t id = writer.writeExpr(*it);
+    writer.write<uint8_t>(ConstraintTag);
+    writer.write(id);
+  }
+
+  for (unsigned f = 0, e = state.stack.size(); f != e; ++f) {
+    StackFrame &sf = state.stack[f];
+    for (unsigned r = 0; r != sf.kf->numRegisters; ++r) {
+      const ref<Expr> &value = (*sf.locals)[r].value;
+      if (value.isNull())
+        continue;
+      uint32_t id = writer.writeExpr(value);
+      writer.write<uint8_t>(LocalTag);
+      writer.write<uint32_t>(f);
+      writer.write<uint32_t>(r);
+      writer.write(id);
+    }
+  }
+
+  AddressSpace &as = state.addressSpace;
+  for (MemoryMap::iterator it = as.objects.begin(), ie = as.objects.end();
+       it != ie; ++it) {
+    const MemoryObject *mo = it->first;
+    ObjectState *os = it->second;
+
+    // Objects not owned by this address space may be referenced by other
+    // states, so writing them out would not free them.
+    if (os->copyOnWriteOwner != as.cowKey) {
+      ss.shared.push_back(std::make_pair(mo, ObjectHolder(os)));
+      continue;
+    }
+
+    std::vector<uint32_t> knownSymbolics;
+    if (os->knownSymbolics) {
+      knownSymbolics.resize(os->size, NoId);
+      for (unsigned i = 0; i != os->size; ++i)
+        if (!os->knownSymbolics[i].isNull())
+          knownSymbolics[i] = writer.writeExpr(os->knownSymbolics[i]);
+    }
+    uint32_t updates = writer.writeUpdates(os->updates.head);
+
+    writer.write<uint8_t>(ObjectTag);
+    writer.write<uint64_t>((uintptr_t) mo);
+    writer.write<uint8_t>(os->readOnly);
+    writer.write<uint64_t>((uintptr_t) os->updates.root);
+    writer.write(updates);
+    writer.writeRaw(os->concreteStore, os->size);
+    writer.writeBits(os->concreteMask, os->size);
+    writer.writeBits(os->flushMask, os->size);
+    writer.write<uint8_t>(os->knownSymbolics != 0);
+    if (os->knownSymbolics)
+      writer.writeRaw(&knownSymbolics[0], os->size * sizeof(uint32_t));
+
+    // Keep the MemoryObject alive until the object is restored.
+    ++mo->refCount;
+    ss.spilled.push_back(mo);
+  }
+  writer.write<uint8_t>(EndTag);
+
+  ss.offset = fileSize;
+  ss.size = buffer.size();
+  file.seekp(ss.offset);
+  file.write(&buffer[0], buffer.size());
+  if (!file)
+    klee_error("unable to write state spill file: %s", path.c_str());
+  fileSize += buffer.size();
+
+  state.constraints = ConstraintManager();
+  for (unsigned f = 0, e = state.stack.size(); f != e; ++f) {
+    // Drop this state's hold on the registers, which may be shared.
+    StackFrame &sf = state.stack[f];
+    sf.locals =
+      CopyOnWrite<std::vector<Cell> >(std::vector<Cell>(sf.kf->numRegisters));
+  }
+  // The bindings hash is kept, the bindings are restored unchanged.
+  as.objects = MemoryMap();
+  state.suspended = true;
+}
+
+void StateSwapper::resume(ExecutionState &state) {
+  std::map<ExecutionState*, SuspendedState>::iterator it =
+    suspended.find(&state);
+  assert(it != suspended.end() && "state not suspended");
+  SuspendedState &ss = it->second;
+
+  std::vector<char> buffer(ss.size);
+  file.seekg(ss.offset);
+  file.read(&buffer[0], ss.size);
+  if (!file)
+    klee_error("unable to read state spill file: %s", path.c_str());
+
+  SpillReader reader(buffer);
+  AddressSpace &as = state.addressSpace;
+  std::vector< ref<Expr> > constraints;
+  for (;;) {
+    SpillTag tag = (SpillTag) reader.read<uint8_t>();
+    if (tag == EndTag)
+      break;
+
+    switch (tag) {
+    case ExprTag:
+      reader.readExpr();
+      break;
+    case UpdateNodeTag:
+      reader.readUpdateNode();
+      break;
+    case ConstraintTag:
+      constraints.push_back(reader.getExpr(reader.read<uint32_t>()));
+      break;
+    case LocalTag: {
+      unsigned f = reader.read<uint32_t>();
+      unsigned r = reader.read<uint32_t>();
+      state.stack[f].locals.getWritable()[r].value =
+        reader.getExpr(reader.read<uint32_t>());
+      break;
+    }
+    case ObjectTag: {
+      const MemoryObject *mo =
+        (const MemoryObject*) (uintptr_t) reader.read<uint64_t>();
+      bool readOnly = reader.read<uint8_t>();
+      const Array *root = (const Array*) (uintptr_t) reader.read<uint64_t>();
+      const UpdateNode *head = reader.getUpdates(reader.read<uint32_t>());
+
+      ObjectState *os = new ObjectState(mo, UpdateList(root, head));
+      os->readOnly = readOnly;
+      reader.readRaw(os->concreteStore, os->size);
+      os->concreteMask = reader.readBits(os->size);
+      os->flushMask = reader.readBits(os->size);
+      if (reader.read<uint8_t>()) {
+        os->knownSymbolics = new ref<Expr>[os->size];
+        for (unsigned i = 0; i != os->size; ++i)
+          os->knownSymbolics[i] = reader.getExpr(reader.read<uint32_t>());
+      }
+
+      os->copyOnWriteOwner = as.cowKey;
+      as.objects = as.objects.replace(std::make_pair(mo, os));
+      break;
+    }
+    default:
+      assert(0 && "invalid spill record");
+    }
+  }
+
+  for (std::vector<std::pair<const MemoryObject*, ObjectHolder> >::iterator
+         sit = ss.shared.begin(), sie = ss.shared.end(); sit != sie; ++sit)
+    as.objects = as.objects.replace(*sit);
+
+  state.constraints = ConstraintManager(constraints);
+  state.constraints.computeRangeFacts();
+  state.suspended = false;
+
+  release(ss);
+  suspended.erase(it);
+  if (suspended.empty())
+    truncate();
+}
+
+void StateSwapper::discard(ExecutionState &state) {
+  std::map<ExecutionState*, SuspendedState>::iterator it =
+    suspended.find(&state);
+  assert(it != suspended.end() && "state not suspended");
+
+  release(it->second);
+  suspended.erase(it);
+  state.suspended = false;
+  if (suspended.empty())
+    truncate();
+}
+
+void StateSwapper::truncate() {
+  // Records are only appended; reclaim the space once none is in use.
+  file.close();
+  file.open(path.c_str(), std::ios::in | std::ios::out | std::ios::trunc |
+                          std::ios::binary);
+  if (!file)
+    klee_error("unable to open state spill file: %s", path.c_str());
+  fileSize = 0;
+}
@@ -0,0 +1,78 @@
+//===-- StateSwapper.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESWAPPER_H
+#define KLEE_STATESWAPPER_H
+
+#include "ObjectHolder.h"
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace klee {
+  class ExecutionState;
+  class MemoryObject;
+
+  /// StateSwapper - Suspends states to a spill file to bound memory usage,
+  /// and restores them when they are needed again.
+  ///
+  /// A suspended state keeps its control flow (pc, stack frames, process
+  /// tree node) and its bookkeeping, so searchers can still weigh and
+  /// select it. Its constraints, the values of its locals and the objects
+  /// it owns are written to the spill file and released. Objects it shares
+  /// with other states stay in memory and are referenced, not written.
+  /// Expressions are written once per state even when reachable from
+  /// several constraints, locals or objects, or through several equal
+  /// nodes, and are restored as a single node.
+  ///
+  /// Expressions the state shared with other states are restored as new
+  /// nodes, so suspending a state that shares much of its expressions can
+  /// increase memory use once it is resumed.
+  class StateSwapper {
+    /// The parts of a suspended state that are not in the spill file.
+    struct SuspendedState {
+      /// Position of the state's record in the spill file.
+      uint64_t offset, size;
+      /// Objects shared with other states, rebound on resume.
+      std::vector<std::pair<const MemoryObject*, ObjectHolder> > shared;
+      /// Objects written to the spill file, kept alive until resumed.
+      std::vector<const MemoryObject*> spilled;
+    };
+
+    std::string path;
+    std::fstream file;
+    uint64_t fileSize;
+    std::map<ExecutionState*, SuspendedState> suspended;
+
+    void release(SuspendedState &ss);
+    void truncate();
+
+  public:
+    explicit StateSwapper(const std::string &path);
+    ~StateSwapper();
+
+    /// Write the contents of \arg state to the spill file and release
+    /// them. \arg state must not be suspended already.
+    void suspend(ExecutionState &state);
+
+    /// Restore a suspended state.
+    void resume(ExecutionState &state);
+
+    /// Forget a suspended state which is being terminated.
+    void discard(ExecutionState &state);
+
+    unsigned getNumSuspended() const { return suspended.size(); }
+  };
+}
+
+#endif
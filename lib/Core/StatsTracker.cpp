@@ -11,6 +11,8 @@
 
 #include "StatsTracker.h"
 
+#include "klee/CommandLine.h"
+#include "klee/Common.h"
 #include "klee/ExecutionState.h"
 #include "klee/Statistics.h"
 #include "klee/Config/Version.h"
@@ -52,12 +54,18 @@
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/CFG.h"
+#include "llvm/Support/InstIterator.h"
 #else
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/IR/InstIterator.h"
 #endif
 
 #include <fstream>
+#include <functional>
+#include <queue>
+#include <signal.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 using namespace klee;
@@ -71,6 +79,11 @@ namespace {
                        cl::desc("Enable tracking of time for individual instructions"),
                        cl::init(false));
 
+  cl::opt<unsigned>
+  InstructionTimeSampleInterval("instruction-time-sample-interval",
+                                cl::desc("With --track-instruction-time, attribute CPU time to the executing instruction every this many microseconds instead of timing every instruction, 0 to time every instruction; wall time is always measured per instruction (default: 1000)"),
+                                cl::init(1000));
+
   cl::opt<bool>
   OutputStats("output-stats",
               cl::desc("Write running stats trace file"),
@@ -101,6 +114,7 @@ namespace {
   // XXX I really would like to have dynamic rate control for something like this.
   cl::opt<double>
   UncoveredUpdateInterval("uncovered-update-interval",
+                          cl::desc("Approximate number of seconds between updates of the per-frame distances to uncovered code (default: 30.0)"),
                           cl::init(30.));
   
   cl::opt<bool>
@@ -137,6 +151,17 @@ namespace klee {
     void run() { statsTracker->writeStatsLine(); }
   };
 
+  class WriteSolverTelemetryTimer : public Executor::Timer {
+    StatsTracker *statsTracker;
+    
+  public:
+    WriteSolverTelemetryTimer(StatsTracker *_statsTracker)
+      : statsTracker(_statsTracker) {}
+    ~WriteSolverTelemetryTimer() {}
+    
+    void run() { statsTracker->writeSolverTelemetry(); }
+  };
+
   class UpdateReachableTimer : public Executor::Timer {
     StatsTracker *statsTracker;
     
@@ -173,6 +198,39 @@ static bool instructionIsCoverable(Instruction *i) {
   return true;
 }
 
+static void updateDistancesForCovered(Instruction *inst);
+
+/// The number of expirations of the profiling timer so far. Only written by
+/// the signal handler, the tracker keeps the number it has attributed.
+static volatile sig_atomic_t timeSamplesTaken = 0;
+
+extern "C" {
+static void profilingTimerHandler(int signal) {
+  timeSamplesTaken = timeSamplesTaken + 1;
+}
+}
+
+/// Start or, with an interval of 0, stop the profiling timer.
+static void setProfilingTimer(unsigned intervalUsec) {
+  struct itimerval timer;
+  timer.it_interval.tv_sec = intervalUsec / 1000000;
+  timer.it_interval.tv_usec = intervalUsec % 1000000;
+  timer.it_value = timer.it_interval;
+
+  if (intervalUsec) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = profilingTimerHandler;
+    // Restart the system calls which allow it; others, such as nanosleep or
+    // select in external calls, still fail with EINTR.
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &action, 0);
+  }
+  setitimer(ITIMER_PROF, &timer, 0);
+  if (!intervalUsec)
+    signal(SIGPROF, SIG_DFL);
+}
+
 StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
                            bool _updateMinDistToUncovered)
   : executor(_executor),
@@ -183,7 +241,10 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     numBranches(0),
     fullBranches(0),
     partialBranches(0),
-    updateMinDistToUncovered(_updateMinDistToUncovered) {
+    updateMinDistToUncovered(_updateMinDistToUncovered),
+    sampleInstructionTime(false),
+    timeSamplesSeen(0),
+    lastStepWallTime(0.) {
   KModule *km = executor.kmodule;
 
   if (!sys::path::is_absolute(objectFilename)) {
@@ -205,26 +266,24 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
   if (OutputIStats)
     theStatisticManager->useIndexedStats(km->infos->getMaxID());
 
-  for (std::vector<KFunction*>::iterator it = km->functions.begin(), 
-         ie = km->functions.end(); it != ie; ++it) {
-    KFunction *kf = *it;
-    kf->trackCoverage = 1;
-
-    for (unsigned i=0; i<kf->numInstructions; ++i) {
-      KInstruction *ki = kf->instructions[i];
+  // KFunctions are built on first call, so the module itself is walked to
+  // account for the functions which are never called.
+  for (Module::iterator fnIt = km->module->begin(),
+         fn_ie = km->module->end(); fnIt != fn_ie; ++fnIt) {
+    for (inst_iterator it = inst_begin(fnIt), ie = inst_end(fnIt); it != ie;
+         ++it) {
+      Instruction *inst = &*it;
 
       if (OutputIStats) {
-        unsigned id = ki->info->id;
+        unsigned id = km->infos->getInfo(inst).id;
         theStatisticManager->setIndex(id);
-        if (kf->trackCoverage && instructionIsCoverable(ki->inst))
+        if (instructionIsCoverable(inst))
           ++stats::uncoveredInstructions;
       }
       
-      if (kf->trackCoverage) {
-        if (BranchInst *bi = dyn_cast<BranchInst>(ki->inst))
-          if (!bi->isUnconditional())
-            numBranches++;
-      }
+      if (BranchInst *bi = dyn_cast<BranchInst>(inst))
+        if (!bi->isUnconditional())
+          numBranches++;
     }
   }
 
@@ -242,15 +301,27 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     }
   }
 
+  if (UseSolverTelemetry)
+    executor.addTimer(new WriteSolverTelemetryTimer(this), StatsWriteInterval);
+
   if (OutputIStats) {
     istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
     assert(istatsFile && "unable to open istats file");
 
     executor.addTimer(new WriteIStatsTimer(this), IStatsWriteInterval);
+
+    if (TrackInstructionTime && InstructionTimeSampleInterval) {
+      sampleInstructionTime = true;
+      lastStepWallTime = util::getWallTime();
+      timeSamplesSeen = timeSamplesTaken;
+      setProfilingTimer(InstructionTimeSampleInterval);
+    }
   }
 }
 
 StatsTracker::~StatsTracker() {  
+  if (sampleInstructionTime)
+    setProfilingTimer(0);
   if (statsFile)
     delete statsFile;
   if (istatsFile)
@@ -262,11 +333,28 @@ void StatsTracker::done() {
     writeStatsLine();
   if (OutputIStats)
     writeIStats();
+  if (UseSolverTelemetry)
+    writeSolverTelemetry();
 }
 
 void StatsTracker::stepInstruction(ExecutionState &es) {
   if (OutputIStats) {
-    if (TrackInstructionTime) {
+    if (sampleInstructionTime) {
+      // The instruction of the previous step is still the indexed one, so
+      // it receives the time of the samples taken while it ran. Wall time
+      // is measured exactly: the forked solver accrues no profiling time,
+      // so a sample can not tell which instruction waited for it.
+      unsigned samples = (unsigned) timeSamplesTaken - timeSamplesSeen;
+      if (samples) {
+        timeSamplesSeen += samples;
+        stats::instructionTime +=
+          (uint64_t) samples * InstructionTimeSampleInterval;
+      }
+      double now = util::getWallTime();
+      stats::instructionRealTime +=
+        (uint64_t) ((now - lastStepWallTime) * 1000000.);
+      lastStepWallTime = now;
+    } else if (TrackInstructionTime) {
       static sys::TimeValue lastNowTime(0,0),lastUserTime(0,0);
     
       if (lastUserTime.seconds()==0 && lastUserTime.nanoseconds()==0) {
@@ -301,11 +389,14 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
         //
         // FIXME: This trick no longer works, we should fix this in the line
         // number propogation.
-          es.coveredLines[&ii.file].insert(ii.line);
+        es.coveredLines =
+          es.coveredLines.insert(std::make_pair(&ii.file, ii.line));
 	es.coveredNew = true;
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
 	stats::uncoveredInstructions += (uint64_t)-1;
+        if (updateMinDistToUncovered)
+          updateDistancesForCovered(inst);
       }
     }
   }
@@ -387,6 +478,7 @@ void StatsTracker::writeStatsHeader() {
              << "'CexCacheTime',"
              << "'ForkTime',"
              << "'ResolveTime',"
+             << "'QueryRangeHits',"
 #ifdef DEBUG
 	     << "'ArrayHashTime',"
 #endif
@@ -421,6 +513,7 @@ void StatsTracker::writeStatsLine() {
              << "," << stats::cexCacheTime / 1000000.
              << "," << stats::forkTime / 1000000.
              << "," << stats::resolveTime / 1000000.
+             << "," << stats::queryRangeHits
 #ifdef DEBUG
              << "," << stats::arrayHashTime / 1000000.
 #endif
@@ -439,6 +532,15 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
   }
 }
 
+void StatsTracker::writeSolverTelemetry() {
+  llvm::raw_ostream *os =
+    executor.interpreterHandler->openOutputFile(SOLVER_TELEMETRY_FILE_NAME);
+  if (os) {
+    klee::writeSolverTelemetry(*os);
+    delete os;
+  }
+}
+
 void StatsTracker::writeIStats() {
   Module *m = executor.kmodule->module;
   uint64_t istatsMask = 0;
@@ -613,6 +715,182 @@ static std::vector<Instruction*> getSuccs(Instruction *i) {
   return res;
 }
 
+/// An edge of the instruction graph used to compute minDistToUncovered:
+/// an instruction is at distance weight plus the distance of node.
+struct DistanceEdge {
+  unsigned node;
+  unsigned weight;
+
+  DistanceEdge(unsigned _node, unsigned _weight)
+    : node(_node), weight(_weight) {}
+};
+
+typedef std::pair<uint64_t, unsigned> DistanceItem;
+typedef std::priority_queue<DistanceItem, std::vector<DistanceItem>,
+                            std::greater<DistanceItem> > DistanceQueue;
+
+static std::map<Instruction*, unsigned> distanceNodes;
+static std::vector<unsigned> distanceNodeIds;
+static std::vector< std::vector<DistanceEdge> > distanceSuccs, distancePreds;
+
+static uint64_t getDistance(unsigned node) {
+  return theStatisticManager->getIndexedValue(stats::minDistToUncovered,
+                                              distanceNodeIds[node]);
+}
+
+static void setDistance(unsigned node, uint64_t dist) {
+  theStatisticManager->setIndexedValue(stats::minDistToUncovered,
+                                       distanceNodeIds[node], dist);
+}
+
+/// Build the graph over which minDistToUncovered is computed. Requires
+/// callTargets and functionShortestPath.
+static void buildDistanceGraph(Module *m, const InstructionInfoTable &infos) {
+  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
+       fnIt != fn_ie; ++fnIt) {
+    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
+         bbIt != bb_ie; ++bbIt) {
+      for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
+           it != ie; ++it) {
+        distanceNodes.insert(std::make_pair(&*it, distanceNodeIds.size()));
+        distanceNodeIds.push_back(infos.getInfo(it).id);
+      }
+    }
+  }
+
+  distanceSuccs.resize(distanceNodeIds.size());
+  distancePreds.resize(distanceNodeIds.size());
+  for (std::map<Instruction*, unsigned>::iterator it = distanceNodes.begin(),
+         ie = distanceNodes.end(); it != ie; ++it) {
+    Instruction *inst = it->first;
+    unsigned node = it->second;
+    unsigned bestThrough = 0;
+
+    if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
+      std::vector<Function*> &targets = callTargets[inst];
+      for (std::vector<Function*>::iterator fnIt = targets.begin(),
+             ie = targets.end(); fnIt != ie; ++fnIt) {
+        uint64_t dist = functionShortestPath[*fnIt];
+        if (dist) {
+          dist = 1+dist; // count instruction itself
+          if (bestThrough==0 || dist<bestThrough)
+            bestThrough = dist;
+        }
+
+        if (!(*fnIt)->isDeclaration()) {
+          unsigned entry = distanceNodes[(*fnIt)->begin()->begin()];
+          distanceSuccs[node].push_back(DistanceEdge(entry, 1));
+          distancePreds[entry].push_back(DistanceEdge(node, 1));
+        }
+      }
+    } else {
+      bestThrough = 1;
+    }
+
+    if (bestThrough) {
+      std::vector<Instruction*> succs = getSuccs(inst);
+      for (std::vector<Instruction*>::iterator it2 = succs.begin(),
+             ie = succs.end(); it2 != ie; ++it2) {
+        unsigned succ = distanceNodes[*it2];
+        distanceSuccs[node].push_back(DistanceEdge(succ, bestThrough));
+        distancePreds[succ].push_back(DistanceEdge(node, bestThrough));
+      }
+    }
+  }
+}
+
+/// Lower distances backwards from the nodes in \arg queue until no
+/// distance improves (Dijkstra's algorithm, 0 being infinity).
+static void propagateDistances(DistanceQueue &queue) {
+  while (!queue.empty()) {
+    DistanceItem item = queue.top();
+    queue.pop();
+    if (getDistance(item.second) != item.first)
+      continue; // stale entry
+
+    std::vector<DistanceEdge> &preds = distancePreds[item.second];
+    for (std::vector<DistanceEdge>::iterator it = preds.begin(),
+           ie = preds.end(); it != ie; ++it) {
+      uint64_t dist = item.first + it->weight;
+      uint64_t cur = getDistance(it->node);
+      if (cur==0 || dist<cur) {
+        setDistance(it->node, dist);
+        queue.push(DistanceItem(dist, it->node));
+      }
+    }
+  }
+}
+
+/// Update minDistToUncovered after \arg inst has been covered. Only the
+/// instructions whose every shortest path led to \arg inst can change;
+/// they are found by walking the graph backwards and then recomputed from
+/// their unaffected successors.
+static void updateDistancesForCovered(Instruction *inst) {
+  std::map<Instruction*, unsigned>::iterator found = distanceNodes.find(inst);
+  if (found == distanceNodes.end())
+    return;
+
+  // Find the affected nodes, remembering their old distances.
+  std::map<unsigned, uint64_t> affected;
+  std::vector<unsigned> stack;
+  affected[found->second] = getDistance(found->second);
+  stack.push_back(found->second);
+  while (!stack.empty()) {
+    unsigned node = stack.back();
+    stack.pop_back();
+    uint64_t nodeDist = affected[node];
+    if (!nodeDist)
+      continue;
+
+    std::vector<DistanceEdge> &preds = distancePreds[node];
+    for (std::vector<DistanceEdge>::iterator it = preds.begin(),
+           ie = preds.end(); it != ie; ++it) {
+      if (affected.count(it->node))
+        continue;
+      uint64_t predDist = getDistance(it->node);
+      if (predDist != nodeDist + it->weight)
+        continue;
+
+      // Is another shortest path still available?
+      bool supported = false;
+      std::vector<DistanceEdge> &succs = distanceSuccs[it->node];
+      for (std::vector<DistanceEdge>::iterator it2 = succs.begin(),
+             ie2 = succs.end(); it2 != ie2 && !supported; ++it2) {
+        if (affected.count(it2->node))
+          continue;
+        uint64_t dist = getDistance(it2->node);
+        supported = dist && dist + it2->weight == predDist;
+      }
+
+      if (!supported) {
+        affected[it->node] = predDist;
+        stack.push_back(it->node);
+      }
+    }
+  }
+
+  // Recompute the affected nodes from their unaffected successors, then
+  // let the new distances settle among the affected nodes.
+  DistanceQueue queue;
+  for (std::map<unsigned, uint64_t>::iterator it = affected.begin(),
+         ie = affected.end(); it != ie; ++it) {
+    uint64_t best = 0;
+    std::vector<DistanceEdge> &succs = distanceSuccs[it->first];
+    for (std::vector<DistanceEdge>::iterator it2 = succs.begin(),
+           ie2 = succs.end(); it2 != ie2; ++it2) {
+      if (affected.count(it2->node))
+        continue;
+      uint64_t dist = getDistance(it2->node);
+      if (dist && (best==0 || dist + it2->weight < best))
+        best = dist + it2->weight;
+    }
+    setDistance(it->first, best);
+    if (best)
+      queue.push(DistanceItem(best, it->first));
+  }
+  propagateDistances(queue);
+}
+
 uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
                                          uint64_t minDistAtRA) {
   StatisticManager &sm = *theStatisticManager;
@@ -771,87 +1049,23 @@ void StatsTracker::computeReachableUncovered() {
         }
       }
     } while (changed);
-  }
 
-  // compute minDistToUncovered, 0 is unreachable
-  std::vector<Instruction *> instructions;
-  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
-       fnIt != fn_ie; ++fnIt) {
-    // Not sure if I should bother to preorder here.
-    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-         bbIt != bb_ie; ++bbIt) {
-      for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-           it != ie; ++it) {
-        unsigned id = infos.getInfo(it).id;
-        instructions.push_back(&*it);
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           id, 
-                           sm.getIndexedValue(stats::uncoveredInstructions, id));
-      }
+    buildDistanceGraph(m, infos);
+
+    // compute minDistToUncovered, 0 is unreachable. Afterwards it is
+    // kept up to date incrementally as instructions get covered.
+    DistanceQueue queue;
+    for (unsigned node = 0, e = distanceNodeIds.size(); node != e; ++node) {
+      uint64_t dist = sm.getIndexedValue(stats::uncoveredInstructions,
+                                         distanceNodeIds[node]);
+      setDistance(node, dist);
+      if (dist)
+        queue.push(DistanceItem(dist, node));
     }
+    propagateDistances(queue);
   }
-  
-  std::reverse(instructions.begin(), instructions.end());
-  
-  // I'm so lazy it's not even worklisted.
-  bool changed;
-  do {
-    changed = false;
-    for (std::vector<Instruction*>::iterator it = instructions.begin(),
-           ie = instructions.end(); it != ie; ++it) {
-      Instruction *inst = *it;
-      uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToUncovered, 
-                                                     infos.getInfo(inst).id);
-      unsigned bestThrough = 0;
-      
-      if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
-        std::vector<Function*> &targets = callTargets[inst];
-        for (std::vector<Function*>::iterator fnIt = targets.begin(),
-               ie = targets.end(); fnIt != ie; ++fnIt) {
-          uint64_t dist = functionShortestPath[*fnIt];
-          if (dist) {
-            dist = 1+dist; // count instruction itself
-            if (bestThrough==0 || dist<bestThrough)
-              bestThrough = dist;
-          }
-
-          if (!(*fnIt)->isDeclaration()) {
-            uint64_t calleeDist = sm.getIndexedValue(stats::minDistToUncovered,
-                                                     infos.getFunctionInfo(*fnIt).id);
-            if (calleeDist) {
-              calleeDist = 1+calleeDist; // count instruction itself
-              if (best==0 || calleeDist<best)
-                best = calleeDist;
-            }
-          }
-        }
-      } else {
-        bestThrough = 1;
-      }
-      
-      if (bestThrough) {
-        std::vector<Instruction*> succs = getSuccs(inst);
-        for (std::vector<Instruction*>::iterator it2 = succs.begin(),
-               ie = succs.end(); it2 != ie; ++it2) {
-          uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered,
-                                             infos.getInfo(*it2).id);
-          if (dist) {
-            uint64_t val = bestThrough + dist;
-            if (best==0 || val<best)
-              best = val;
-          }
-        }
-      }
-
-      if (best != cur) {
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           infos.getInfo(inst).id, 
-                           best);
-        changed = true;
-      }
-    }
-  } while (changed);
 
+  // Refresh the distances of the stack frames of every state.
   for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
     ExecutionState *es = *it;
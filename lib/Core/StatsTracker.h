@@ -32,6 +32,7 @@ namespace klee {
   class StatsTracker {
     friend class WriteStatsTimer;
     friend class WriteIStatsTimer;
+    friend class WriteSolverTelemetryTimer;
 
     Executor &executor;
     std::string objectFilename;
@@ -46,6 +47,14 @@ namespace klee {
 
     bool updateMinDistToUncovered;
 
+    /// Whether instruction CPU times are sampled with a profiling timer
+    /// rather than measured at every step.
+    bool sampleInstructionTime;
+    /// The number of timer samples already attributed to instructions.
+    unsigned timeSamplesSeen;
+    /// The wall time of the last step, when sampling.
+    double lastStepWallTime;
+
   public:
     static bool useStatistics();
 
@@ -54,6 +63,7 @@ namespace klee {
     void writeStatsHeader();
     void writeStatsLine();
     void writeIStats();
+    void writeSolverTelemetry();
 
   public:
     StatsTracker(Executor &_executor, std::string _objectFilename,
@@ -24,6 +24,18 @@ using namespace llvm;
 
 /***/
 
+/// Attempt to decide \arg expr using only the intervals and known bits
+/// implied by the path condition of \arg state.
+bool TimingSolver::decideByRanges(const ExecutionState& state, ref<Expr> expr,
+                                  bool &result) {
+  if (!useRangeFacts)
+    return false;
+  if (!state.constraints.getRangeFacts().decide(expr, result))
+    return false;
+  ++stats::queryRangeHits;
+  return true;
+}
+
 bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
                             Solver::Validity &result) {
   // Fast path, to avoid timer and OS overhead.
@@ -37,7 +49,12 @@ bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
 
-  bool success = solver->evaluate(Query(state.constraints, expr), result);
+  bool success = true, value;
+  if (decideByRanges(state, expr, value)) {
+    result = value ? Solver::True : Solver::False;
+  } else {
+    success = solver->evaluate(Query(state.constraints, expr), result);
+  }
 
   sys::TimeValue delta = util::getWallTimeVal();
   delta -= now;
@@ -60,7 +77,9 @@ bool TimingSolver::mustBeTrue(const ExecutionState& state, ref<Expr> expr,
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
 
-  bool success = solver->mustBeTrue(Query(state.constraints, expr), result);
+  bool success = true;
+  if (!decideByRanges(state, expr, result))
+    success = solver->mustBeTrue(Query(state.constraints, expr), result);
 
   sys::TimeValue delta = util::getWallTimeVal();
   delta -= now;
@@ -93,6 +112,70 @@ bool TimingSolver::mayBeFalse(const ExecutionState& state, ref<Expr> expr,
   return true;
 }
 
+bool TimingSolver::mayBeTrue(const ExecutionState& state,
+                             const std::vector< ref<Expr> > &exprs,
+                             std::vector<bool> &results) {
+  results.assign(exprs.size(), false);
+
+  // Decide what we can locally and send the rest as one batch.
+  std::vector< ref<Expr> > pending;
+  std::vector<unsigned> indices;
+  sys::TimeValue now = util::getWallTimeVal();
+
+  for (unsigned i = 0, e = exprs.size(); i != e; ++i) {
+    ref<Expr> expr = exprs[i];
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+      results[i] = CE->isTrue();
+      continue;
+    }
+
+    if (simplifyExprs)
+      expr = state.constraints.simplifyExpr(expr);
+
+    bool value;
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+      results[i] = CE->isTrue();
+    } else if (decideByRanges(state, expr, value)) {
+      results[i] = value;
+    } else {
+      pending.push_back(expr);
+      indices.push_back(i);
+    }
+  }
+
+  bool success = true;
+  if (!pending.empty()) {
+    std::vector<bool> pendingResults;
+    success = solver->mayBeTrue(state.constraints, pending, pendingResults);
+    if (success)
+      for (unsigned i = 0, e = indices.size(); i != e; ++i)
+        results[indices[i]] = pendingResults[i];
+  }
+
+  sys::TimeValue delta = util::getWallTimeVal();
+  delta -= now;
+  stats::solverTime += delta.usec();
+  state.queryCost += delta.usec()/1000000.;
+
+  return success;
+}
+
+bool TimingSolver::mustBeTrue(const ExecutionState& state,
+                              const std::vector< ref<Expr> > &exprs,
+                              std::vector<bool> &results) {
+  std::vector< ref<Expr> > negated;
+  negated.reserve(exprs.size());
+  for (std::vector< ref<Expr> >::const_iterator it = exprs.begin(),
+         ie = exprs.end(); it != ie; ++it)
+    negated.push_back(Expr::createIsZero(*it));
+
+  if (!mayBeTrue(state, negated, results))
+    return false;
+
+  results.flip();
+  return true;
+}
+
 bool TimingSolver::getValue(const ExecutionState& state, ref<Expr> expr, 
                             ref<ConstantExpr> &result) {
   // Fast path, to avoid timer and OS overhead.
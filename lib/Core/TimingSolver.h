@@ -25,6 +25,10 @@ namespace klee {
   public:
     Solver *solver;
     bool simplifyExprs;
+    bool useRangeFacts;
+
+  private:
+    bool decideByRanges(const ExecutionState&, ref<Expr>, bool &result);
 
   public:
     /// TimingSolver - Construct a new timing solver.
@@ -32,8 +36,12 @@ namespace klee {
     /// \param _simplifyExprs - Whether expressions should be
     /// simplified (via the constraint manager interface) prior to
     /// querying.
-    TimingSolver(Solver *_solver, bool _simplifyExprs = true) 
-      : solver(_solver), simplifyExprs(_simplifyExprs) {}
+    /// \param _useRangeFacts - Whether queries decided by the range
+    /// facts of the state should be answered without the solver.
+    TimingSolver(Solver *_solver, bool _simplifyExprs = true,
+                 bool _useRangeFacts = true) 
+      : solver(_solver), simplifyExprs(_simplifyExprs),
+        useRangeFacts(_useRangeFacts) {}
     ~TimingSolver() {
       delete solver;
     }
@@ -56,6 +64,16 @@ namespace klee {
 
     bool mayBeFalse(const ExecutionState&, ref<Expr>, bool &result);
 
+    /// mayBeTrue - Batched form of mayBeTrue, answering all expressions
+    /// with as few solver queries as possible.
+    bool mayBeTrue(const ExecutionState&, const std::vector< ref<Expr> > &exprs,
+                   std::vector<bool> &results);
+
+    /// mustBeTrue - Batched form of mustBeTrue.
+    bool mustBeTrue(const ExecutionState&,
+                    const std::vector< ref<Expr> > &exprs,
+                    std::vector<bool> &results);
+
     bool getValue(const ExecutionState &, ref<Expr> expr, 
                   ref<ConstantExpr> &result);
 
@@ -26,6 +26,8 @@ namespace {
 			clEnumValN(Searcher::BFS, "bfs", "use Breadth First Search (BFS)"),
 			clEnumValN(Searcher::RandomState, "random-state", "randomly select a state to explore"),
 			clEnumValN(Searcher::RandomPath, "random-path", "use Random Path Selection (see OSDI'08 paper)"),
+			clEnumValN(Searcher::RandomPath_MD2U, "random-path:md2u", "use Random Path Selection weighted by the Min-Dist-to-Uncovered of each subtree"),
+			clEnumValN(Searcher::RandomPath_QC, "random-path:qc", "use Random Path Selection weighted by the Query-Cost of each subtree"),
 			clEnumValN(Searcher::NURS_CovNew, "nurs:covnew", "use Non Uniform Random Search (NURS) with Coverage-New"),
 			clEnumValN(Searcher::NURS_MD2U, "nurs:md2u", "use NURS with Min-Dist-to-Uncovered"),
 			clEnumValN(Searcher::NURS_Depth, "nurs:depth", "use NURS with 2^depth"),
@@ -62,6 +64,24 @@ namespace {
   UseBumpMerge("use-bump-merge", 
            cl::desc("Enable support for klee_merge() (extra experimental)"));
 
+  cl::opt<bool>
+  UseRegionMerge("use-region-merge",
+                 cl::desc("Merge the states forked by a branch at the exit of its acyclic region (experimental)"));
+
+  cl::opt<unsigned>
+  RegionMergeMaxBlocks("region-merge-max-blocks",
+                       cl::desc("Maximum number of basic blocks in a region merged by --use-region-merge (default=32)"),
+                       cl::init(32));
+
+  cl::opt<bool>
+  UseDynamicMerge("use-dynamic-merge",
+                  cl::desc("Merge the selected state with similar states at the same instruction (experimental)"));
+
+  cl::opt<unsigned>
+  DynamicMergeMaxCost("dynamic-merge-max-cost",
+                      cl::desc("Maximum estimated cost of a merge done by --use-dynamic-merge (default=32)"),
+                      cl::init(32));
+
 }
 
 
@@ -70,7 +90,8 @@ bool klee::userSearcherRequiresMD2U() {
 	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_CovNew) != CoreSearch.end() ||
 	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_ICnt) != CoreSearch.end() ||
 	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_CPICnt) != CoreSearch.end() ||
-	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_QC) != CoreSearch.end());
+	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_QC) != CoreSearch.end() ||
+	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::RandomPath_MD2U) != CoreSearch.end());
 }
 
 
@@ -87,6 +108,8 @@ Searcher *getNewSearcher(Searcher::CoreSearchType type, Executor &executor) {
   case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount); break;
   case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount); break;
   case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost); break;
+  case Searcher::RandomPath_MD2U: searcher = new WeightedRandomPathSearcher(executor, WeightedRandomPathSearcher::MinDistToUncovered); break;
+  case Searcher::RandomPath_QC: searcher = new WeightedRandomPathSearcher(executor, WeightedRandomPathSearcher::QueryCost); break;
   }
 
   return searcher;
@@ -123,6 +146,12 @@ Searcher *klee::constructUserSearcher(Executor &executor) {
     searcher = new MergingSearcher(executor, searcher);
   } else if (UseBumpMerge) {
     searcher = new BumpMergingSearcher(executor, searcher);
+  } else if (UseRegionMerge) {
+    searcher = new RegionMergingSearcher(executor, searcher,
+                                         RegionMergeMaxBlocks);
+  } else if (UseDynamicMerge) {
+    searcher = new DynamicMergingSearcher(executor, searcher,
+                                          DynamicMergeMaxCost);
   }
   
   if (UseIterativeDeepeningTimeSearch) {
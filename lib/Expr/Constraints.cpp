@@ -19,8 +19,6 @@
 #include "llvm/Support/CommandLine.h"
 #include "klee/Internal/Module/KModule.h"
 
-#include <map>
-
 using namespace klee;
 
 namespace {
@@ -57,18 +55,18 @@ public:
 
 class ExprReplaceVisitor2 : public ExprVisitor {
 private:
-  const std::map< ref<Expr>, ref<Expr> > &replacements;
+  const ConstraintManager::equalities_ty &replacements;
 
 public:
-  ExprReplaceVisitor2(const std::map< ref<Expr>, ref<Expr> > &_replacements) 
+  ExprReplaceVisitor2(const ConstraintManager::equalities_ty &_replacements) 
     : ExprVisitor(true),
       replacements(_replacements) {}
 
   Action visitExprPost(const Expr &e) {
-    std::map< ref<Expr>, ref<Expr> >::const_iterator it =
-      replacements.find(ref<Expr>(const_cast<Expr*>(&e)));
-    if (it!=replacements.end()) {
-      return Action::changeTo(it->second);
+    const ConstraintManager::equalities_ty::value_type *res =
+      replacements.lookup(ref<Expr>(const_cast<Expr*>(&e)));
+    if (res) {
+      return Action::changeTo(res->second);
     } else {
       return Action::doChildren();
     }
@@ -93,9 +91,35 @@ bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
     }
   }
 
+  // the substitutions of rewritten constraints are stale
+  if (changed)
+    rebuildEqualities();
+
   return changed;
 }
 
+/// Record the substitution implied by the (already added) constraint \arg e.
+/// Earlier constraints take precedence, as insert does not replace an
+/// existing key.
+void ConstraintManager::addEquality(ref<Expr> e) const {
+  if (const EqExpr *ee = dyn_cast<EqExpr>(e)) {
+    if (isa<ConstantExpr>(ee->left)) {
+      equalities = equalities.insert(std::make_pair(ee->right, ee->left));
+      return;
+    }
+  }
+  equalities = equalities.insert(std::make_pair(e,
+                                                ConstantExpr::alloc(1, Expr::Bool)));
+}
+
+void ConstraintManager::rebuildEqualities() const {
+  equalities = equalities_ty();
+  for (ConstraintManager::constraints_ty::const_iterator 
+         it = constraints.begin(), ie = constraints.end(); it != ie; ++it)
+    addEquality(*it);
+  equalitiesStale = false;
+}
+
 void ConstraintManager::simplifyForValidConstraint(ref<Expr> e) {
   // XXX 
 }
@@ -104,23 +128,11 @@ ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
   if (isa<ConstantExpr>(e))
     return e;
 
-  std::map< ref<Expr>, ref<Expr> > equalities;
-  
-  for (ConstraintManager::constraints_ty::const_iterator 
-         it = constraints.begin(), ie = constraints.end(); it != ie; ++it) {
-    if (const EqExpr *ee = dyn_cast<EqExpr>(*it)) {
-      if (isa<ConstantExpr>(ee->left)) {
-        equalities.insert(std::make_pair(ee->right,
-                                         ee->left));
-      } else {
-        equalities.insert(std::make_pair(*it,
-                                         ConstantExpr::alloc(1, Expr::Bool)));
-      }
-    } else {
-      equalities.insert(std::make_pair(*it,
-                                       ConstantExpr::alloc(1, Expr::Bool)));
-    }
-  }
+  if (equalitiesStale)
+    rebuildEqualities();
+
+  if (equalities.empty())
+    return e;
 
   return ExprReplaceVisitor2(equalities).visit(e);
 }
@@ -156,15 +168,26 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
       }
     }
     constraints.push_back(e);
+    addEquality(e);
+    rangeFacts.addConstraint(e);
     break;
   }
     
   default:
     constraints.push_back(e);
+    addEquality(e);
+    rangeFacts.addConstraint(e);
     break;
   }
 }
 
+void ConstraintManager::computeRangeFacts() {
+  rangeFacts = RangeFacts();
+  for (constraints_ty::iterator it = constraints.begin(),
+         ie = constraints.end(); it != ie; ++it)
+    rangeFacts.addConstraint(*it);
+}
+
 void ConstraintManager::addConstraint(ref<Expr> e) {
   e = simplifyExpr(e);
   addConstraintInternal(e);
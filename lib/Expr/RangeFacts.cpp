@@ -0,0 +1,613 @@
+//===-- RangeFacts.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/RangeFacts.h"
+
+#include "klee/util/Bits.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+/***/
+
+/// smear - Set all bits below the highest set bit of \arg x.
+static uint64_t smear(uint64_t x) {
+  x |= x >> 1;
+  x |= x >> 2;
+  x |= x >> 4;
+  x |= x >> 8;
+  x |= x >> 16;
+  x |= x >> 32;
+  return x;
+}
+
+KnownBitsRange::KnownBitsRange(unsigned _width)
+  : width(_width), m_min(0), m_max(getMask()), knownZero(0), knownOne(0) {}
+
+KnownBitsRange::KnownBitsRange(unsigned _width, uint64_t value)
+  : width(_width), m_min(value), m_max(value), knownZero(0), knownOne(0) {
+  normalize();
+}
+
+KnownBitsRange::KnownBitsRange(unsigned _width, uint64_t _min, uint64_t _max,
+                               uint64_t _knownZero, uint64_t _knownOne)
+  : width(_width), m_min(_min), m_max(_max),
+    knownZero(_knownZero), knownOne(_knownOne) {
+  normalize();
+}
+
+uint64_t KnownBitsRange::getMask() const {
+  return width >= 64 ? ~(uint64_t) 0 : bits64::maxValueOfNBits(width);
+}
+
+bool KnownBitsRange::isFull() const {
+  return !isTracked() ||
+    (m_min == 0 && m_max == getMask() && !knownZero && !knownOne);
+}
+
+void KnownBitsRange::makeEmpty() {
+  m_min = 1;
+  m_max = 0;
+  knownZero = knownOne = 0;
+}
+
+void KnownBitsRange::normalize() {
+  if (!isTracked()) {
+    m_min = 0;
+    m_max = ~(uint64_t) 0;
+    knownZero = knownOne = 0;
+    return;
+  }
+
+  uint64_t mask = getMask();
+  knownZero &= mask;
+  knownOne &= mask;
+  m_max = std::min(m_max, mask);
+  if (isEmpty() || (knownZero & knownOne))
+    return makeEmpty();
+
+  // the known bits bound the interval
+  m_min = std::max(m_min, knownOne);
+  m_max = std::min(m_max, mask & ~knownZero);
+  if (isEmpty())
+    return makeEmpty();
+
+  // and the bits above the highest bit in which the bounds differ are
+  // shared by every value of the interval
+  uint64_t prefix = mask & ~smear(m_min ^ m_max);
+  if ((knownOne & prefix & ~m_min) || (knownZero & prefix & m_min))
+    return makeEmpty();
+  knownOne |= m_min & prefix;
+  knownZero |= ~m_min & prefix;
+}
+
+static int64_t signExtend(uint64_t value, unsigned width) {
+  if (width >= 64)
+    return (int64_t) value;
+  uint64_t signBit = (uint64_t) 1 << (width - 1);
+  if (value & signBit)
+    return (int64_t) (value | ~bits64::maxValueOfNBits(width));
+  return (int64_t) value;
+}
+
+int64_t KnownBitsRange::minSigned() const {
+  assert(!isEmpty() && isTracked() && "invalid range");
+  uint64_t signBit = (uint64_t) 1 << (width - 1);
+  if (m_min >= signBit)
+    return signExtend(m_min, width);
+  if (m_max >= signBit)
+    return signExtend(signBit, width);
+  return (int64_t) m_min;
+}
+
+int64_t KnownBitsRange::maxSigned() const {
+  assert(!isEmpty() && isTracked() && "invalid range");
+  uint64_t signBit = (uint64_t) 1 << (width - 1);
+  if (m_max < signBit)
+    return (int64_t) m_max;
+  if (m_min < signBit)
+    return (int64_t) (signBit - 1);
+  return signExtend(m_max, width);
+}
+
+bool KnownBitsRange::mayEqual(const KnownBitsRange &b) const {
+  return !meet(b).isEmpty();
+}
+
+KnownBitsRange KnownBitsRange::meet(const KnownBitsRange &b) const {
+  if (!isTracked())
+    return *this;
+  if (isEmpty())
+    return *this;
+  if (b.isEmpty())
+    return b;
+  return KnownBitsRange(width,
+                        std::max(m_min, b.m_min), std::min(m_max, b.m_max),
+                        knownZero | b.knownZero, knownOne | b.knownOne);
+}
+
+KnownBitsRange KnownBitsRange::join(const KnownBitsRange &b) const {
+  if (!isTracked())
+    return *this;
+  if (isEmpty())
+    return b;
+  if (b.isEmpty())
+    return *this;
+  return KnownBitsRange(width,
+                        std::min(m_min, b.m_min), std::max(m_max, b.m_max),
+                        knownZero & b.knownZero, knownOne & b.knownOne);
+}
+
+KnownBitsRange KnownBitsRange::exclude(uint64_t value) const {
+  if (!isTracked() || isEmpty())
+    return *this;
+  if (value == m_min)
+    return KnownBitsRange(width, m_min + 1, m_max, knownZero, knownOne);
+  if (value == m_max)
+    return KnownBitsRange(width, m_min, m_max - 1, knownZero, knownOne);
+  return *this;
+}
+
+/***/
+
+namespace {
+  class RangeFactsEvaluator {
+    const RangeFacts::facts_ty &facts;
+    ExprHashMap<KnownBitsRange> cache;
+
+    KnownBitsRange evaluateStructure(const ref<Expr> &e);
+
+  public:
+    RangeFactsEvaluator(const RangeFacts::facts_ty &_facts) : facts(_facts) {}
+
+    KnownBitsRange evaluate(const ref<Expr> &e);
+  };
+}
+
+KnownBitsRange RangeFactsEvaluator::evaluate(const ref<Expr> &e) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+    if (CE->getWidth() > 64)
+      return KnownBitsRange(CE->getWidth());
+    return KnownBitsRange(CE->getWidth(), CE->getZExtValue());
+  }
+
+  ExprHashMap<KnownBitsRange>::iterator it = cache.find(e);
+  if (it != cache.end())
+    return it->second;
+
+  KnownBitsRange res = evaluateStructure(e);
+  if (const RangeFacts::facts_ty::value_type *fact = facts.lookup(e)) {
+    // contradicting facts only arise on infeasible paths, keep whatever
+    // the structure tells us
+    KnownBitsRange refined = res.meet(fact->second);
+    if (!refined.isEmpty())
+      res = refined;
+  }
+
+  cache.insert(std::make_pair(e, res));
+  return res;
+}
+
+KnownBitsRange RangeFactsEvaluator::evaluateStructure(const ref<Expr> &e) {
+  Expr::Width width = e->getWidth();
+  KnownBitsRange top(width);
+  if (!top.isTracked())
+    return top;
+  uint64_t mask = top.getMask();
+
+  switch (e->getKind()) {
+  case Expr::NotOptimized:
+    return evaluate(e->getKid(0));
+
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    const Array *array = re->updates.root;
+    if (!re->updates.head && array->isConstantArray()) {
+      if (ConstantExpr *index = dyn_cast<ConstantExpr>(re->index)) {
+        uint64_t i = index->getZExtValue();
+        if (i < array->size)
+          return KnownBitsRange(width,
+                                array->constantValues[i]->getZExtValue(8));
+      }
+    }
+    return top;
+  }
+
+  case Expr::Select: {
+    const SelectExpr *se = cast<SelectExpr>(e);
+    KnownBitsRange cond = evaluate(se->cond);
+    if (cond.isFixed())
+      return evaluate(cond.min() ? se->trueExpr : se->falseExpr);
+    return evaluate(se->trueExpr).join(evaluate(se->falseExpr));
+  }
+
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    KnownBitsRange l = evaluate(ce->getLeft()), r = evaluate(ce->getRight());
+    if (l.isEmpty() || r.isEmpty())
+      return top;
+    unsigned shift = r.getWidth();
+    return KnownBitsRange(width,
+                          (l.min() << shift) | r.min(),
+                          (l.max() << shift) | r.max(),
+                          (l.getKnownZero() << shift) | r.getKnownZero(),
+                          (l.getKnownOne() << shift) | r.getKnownOne());
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    KnownBitsRange v = evaluate(ee->expr);
+    if (v.isEmpty() || !v.isTracked())
+      return top;
+    unsigned offset = ee->offset;
+    uint64_t lo = v.min() >> offset, hi = v.max() >> offset;
+    uint64_t knownZero = (v.getKnownZero() >> offset) & mask;
+    uint64_t knownOne = (v.getKnownOne() >> offset) & mask;
+    // the interval survives truncation if the discarded bits are constant
+    if ((lo & ~mask) == (hi & ~mask))
+      return KnownBitsRange(width, lo & mask, hi & mask, knownZero, knownOne);
+    return KnownBitsRange(width, 0, mask, knownZero, knownOne);
+  }
+
+  case Expr::ZExt: {
+    const CastExpr *ce = cast<CastExpr>(e);
+    KnownBitsRange v = evaluate(ce->src);
+    if (v.isEmpty())
+      return top;
+    return KnownBitsRange(width, v.min(), v.max(),
+                          v.getKnownZero() | (mask & ~v.getMask()),
+                          v.getKnownOne());
+  }
+
+  case Expr::SExt: {
+    const CastExpr *ce = cast<CastExpr>(e);
+    KnownBitsRange v = evaluate(ce->src);
+    if (v.isEmpty())
+      return top;
+    uint64_t signBit = (uint64_t) 1 << (v.getWidth() - 1);
+    uint64_t ext = mask & ~v.getMask();
+    if (v.max() < signBit)
+      return KnownBitsRange(width, v.min(), v.max(),
+                            v.getKnownZero() | ext, v.getKnownOne());
+    if (v.min() >= signBit)
+      return KnownBitsRange(width, v.min() | ext, v.max() | ext,
+                            v.getKnownZero(), v.getKnownOne() | ext);
+    return KnownBitsRange(width, 0, mask,
+                          v.getKnownZero() & ~signBit,
+                          v.getKnownOne() & ~signBit);
+  }
+
+    // Arithmetic
+
+  case Expr::Add: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty())
+      return top;
+    if (l.max() <= mask - r.max())
+      return KnownBitsRange(width, l.min() + r.min(), l.max() + r.max());
+    if (l.min() > mask - r.min()) // every sum wraps exactly once
+      return KnownBitsRange(width, (l.min() + r.min()) & mask,
+                            (l.max() + r.max()) & mask);
+    return top;
+  }
+
+  case Expr::Sub: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty())
+      return top;
+    if (l.min() >= r.max())
+      return KnownBitsRange(width, l.min() - r.max(), l.max() - r.min());
+    if (l.max() < r.min()) // every difference wraps exactly once
+      return KnownBitsRange(width, (l.min() - r.max()) & mask,
+                            (l.max() - r.min()) & mask);
+    return top;
+  }
+
+  case Expr::Mul: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty())
+      return top;
+    if (r.max() == 0 || l.max() <= mask / r.max())
+      return KnownBitsRange(width, l.min() * r.min(), l.max() * r.max());
+    return top;
+  }
+
+  case Expr::UDiv: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty() || r.min() == 0)
+      return top;
+    return KnownBitsRange(width, l.min() / r.max(), l.max() / r.min());
+  }
+
+  case Expr::URem: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty() || r.min() == 0)
+      return top;
+    if (l.max() < r.min())
+      return l;
+    return KnownBitsRange(width, 0, std::min(l.max(), r.max() - 1));
+  }
+
+    // Bitwise
+
+  case Expr::Not: {
+    KnownBitsRange v = evaluate(e->getKid(0));
+    if (v.isEmpty())
+      return top;
+    return KnownBitsRange(width, ~v.max() & mask, ~v.min() & mask,
+                          v.getKnownOne(), v.getKnownZero());
+  }
+
+  case Expr::And: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty())
+      return top;
+    return KnownBitsRange(width, 0, std::min(l.max(), r.max()),
+                          l.getKnownZero() | r.getKnownZero(),
+                          l.getKnownOne() & r.getKnownOne());
+  }
+
+  case Expr::Or: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty())
+      return top;
+    return KnownBitsRange(width, std::max(l.min(), r.min()),
+                          smear(l.max() | r.max()),
+                          l.getKnownZero() & r.getKnownZero(),
+                          l.getKnownOne() | r.getKnownOne());
+  }
+
+  case Expr::Xor: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty())
+      return top;
+    return KnownBitsRange(width, 0, smear(l.max() | r.max()),
+                          (l.getKnownZero() & r.getKnownZero()) |
+                          (l.getKnownOne() & r.getKnownOne()),
+                          (l.getKnownZero() & r.getKnownOne()) |
+                          (l.getKnownOne() & r.getKnownZero()));
+  }
+
+  case Expr::Shl: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || !r.isFixed() || r.min() >= width)
+      return top;
+    unsigned shift = r.min();
+    uint64_t knownZero = ((l.getKnownZero() << shift) |
+                          bits64::maxValueOfNBits(shift)) & mask;
+    uint64_t knownOne = (l.getKnownOne() << shift) & mask;
+    if (l.max() <= (mask >> shift))
+      return KnownBitsRange(width, l.min() << shift, l.max() << shift,
+                            knownZero, knownOne);
+    return KnownBitsRange(width, 0, mask, knownZero, knownOne);
+  }
+
+  case Expr::LShr: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty() || r.max() >= width)
+      return top;
+    if (!r.isFixed())
+      return KnownBitsRange(width, l.min() >> r.max(), l.max() >> r.min());
+    unsigned shift = r.min();
+    return KnownBitsRange(width, l.min() >> shift, l.max() >> shift,
+                          (l.getKnownZero() >> shift) | (mask & ~(mask >> shift)),
+                          l.getKnownOne() >> shift);
+  }
+
+    // Comparison
+
+  case Expr::Eq:
+  case Expr::Ne: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty())
+      return top;
+    bool isEq = e->getKind() == Expr::Eq;
+    if (l.isFixed() && r.isFixed() && l.min() == r.min())
+      return KnownBitsRange(width, isEq);
+    if (!l.mayEqual(r))
+      return KnownBitsRange(width, !isEq);
+    return top;
+  }
+
+  case Expr::Ult:
+  case Expr::Ule:
+  case Expr::Ugt:
+  case Expr::Uge: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty() || !l.isTracked())
+      return top;
+    Expr::Kind k = e->getKind();
+    if (k == Expr::Ugt || k == Expr::Uge)
+      std::swap(l, r);
+    bool strict = k == Expr::Ult || k == Expr::Ugt;
+    if (strict ? l.max() < r.min() : l.max() <= r.min())
+      return KnownBitsRange(width, 1);
+    if (strict ? l.min() >= r.max() : l.min() > r.max())
+      return KnownBitsRange(width, 0);
+    return top;
+  }
+
+  case Expr::Slt:
+  case Expr::Sle:
+  case Expr::Sgt:
+  case Expr::Sge: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    KnownBitsRange l = evaluate(be->left), r = evaluate(be->right);
+    if (l.isEmpty() || r.isEmpty() || !l.isTracked())
+      return top;
+    Expr::Kind k = e->getKind();
+    if (k == Expr::Sgt || k == Expr::Sge)
+      std::swap(l, r);
+    bool strict = k == Expr::Slt || k == Expr::Sgt;
+    if (strict ? l.maxSigned() < r.minSigned() :
+        l.maxSigned() <= r.minSigned())
+      return KnownBitsRange(width, 1);
+    if (strict ? l.minSigned() >= r.maxSigned() :
+        l.minSigned() > r.maxSigned())
+      return KnownBitsRange(width, 0);
+    return top;
+  }
+
+  default:
+    return top;
+  }
+}
+
+/***/
+
+void RangeFacts::restrict(ref<Expr> e, const KnownBitsRange &range) {
+  if (isa<ConstantExpr>(e) || !range.isTracked())
+    return;
+
+  const facts_ty::value_type *fact = facts.lookup(e);
+  KnownBitsRange current = fact ? fact->second : KnownBitsRange(e->getWidth());
+  KnownBitsRange refined = current.meet(range);
+  if (refined.isEmpty() || refined == current)
+    return;
+  facts = facts.replace(std::make_pair(e, refined));
+
+  // push the new bounds through operations which are invertible on them
+  switch (e->getKind()) {
+  case Expr::ZExt: {
+    ref<Expr> src = cast<CastExpr>(e)->src;
+    KnownBitsRange srcRange(src->getWidth());
+    uint64_t srcMask = srcRange.getMask();
+    if (refined.min() <= srcMask)
+      restrict(src, KnownBitsRange(src->getWidth(), refined.min(),
+                                   std::min(refined.max(), srcMask),
+                                   refined.getKnownZero() & srcMask,
+                                   refined.getKnownOne() & srcMask));
+    break;
+  }
+
+  case Expr::Add: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(be->left)) {
+      uint64_t c = CE->getZExtValue(), mask = refined.getMask();
+      if (refined.min() >= c)
+        restrict(be->right, KnownBitsRange(e->getWidth(), refined.min() - c,
+                                           refined.max() - c));
+      else if (refined.max() < c)
+        restrict(be->right, KnownBitsRange(e->getWidth(),
+                                           (refined.min() - c) & mask,
+                                           (refined.max() - c) & mask));
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+void RangeFacts::learn(ref<Expr> e, bool value) {
+  switch (e->getKind()) {
+  case Expr::Constant:
+    return;
+
+  case Expr::And:
+    if (value && e->getWidth() == Expr::Bool) {
+      const BinaryExpr *be = cast<BinaryExpr>(e);
+      learn(be->left, true);
+      learn(be->right, true);
+    }
+    break;
+
+  case Expr::Or:
+    if (!value && e->getWidth() == Expr::Bool) {
+      const BinaryExpr *be = cast<BinaryExpr>(e);
+      learn(be->left, false);
+      learn(be->right, false);
+    }
+    break;
+
+  case Expr::Eq: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    ConstantExpr *CE = dyn_cast<ConstantExpr>(be->left);
+    if (!CE || CE->getWidth() > 64)
+      break;
+    if (CE->getWidth() == Expr::Bool && CE->isFalse()) {
+      learn(be->right, !value);
+    } else if (value) {
+      restrict(be->right, KnownBitsRange(CE->getWidth(), CE->getZExtValue()));
+    } else {
+      const facts_ty::value_type *fact = facts.lookup(be->right);
+      KnownBitsRange current =
+        fact ? fact->second : KnownBitsRange(CE->getWidth());
+      restrict(be->right, current.exclude(CE->getZExtValue()));
+    }
+    break;
+  }
+
+  case Expr::Ult:
+  case Expr::Ule: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    unsigned width = be->left->getWidth();
+    if (width > 64)
+      break;
+    uint64_t mask = KnownBitsRange(width).getMask();
+    // !(l < r) is (r <= l) and !(l <= r) is (r < l)
+    bool strict = (e->getKind() == Expr::Ult) == value;
+    ref<Expr> l = value ? be->left : be->right;
+    ref<Expr> r = value ? be->right : be->left;
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(r)) {
+      uint64_t c = CE->getZExtValue();
+      if (!strict)
+        restrict(l, KnownBitsRange(width, 0, c));
+      else if (c > 0)
+        restrict(l, KnownBitsRange(width, 0, c - 1));
+    } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(l)) {
+      uint64_t c = CE->getZExtValue();
+      if (!strict)
+        restrict(r, KnownBitsRange(width, c, mask));
+      else if (c < mask)
+        restrict(r, KnownBitsRange(width, c + 1, mask));
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+
+  if (e->getWidth() == Expr::Bool)
+    restrict(e, KnownBitsRange(Expr::Bool, value));
+}
+
+void RangeFacts::addConstraint(ref<Expr> e) {
+  learn(e, true);
+}
+
+KnownBitsRange RangeFacts::evaluate(ref<Expr> e) const {
+  RangeFactsEvaluator evaluator(facts);
+  return evaluator.evaluate(e);
+}
+
+bool RangeFacts::decide(ref<Expr> e, bool &value) const {
+  assert(e->getWidth() == Expr::Bool && "non-boolean expression");
+  KnownBitsRange res = evaluate(e);
+  if (!res.isFixed())
+    return false;
+  value = res.min() != 0;
+  return true;
+}
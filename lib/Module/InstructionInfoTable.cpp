@@ -46,8 +46,11 @@
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Support/ErrorHandling.h"
 
+#include <istream>
 #include <map>
+#include <ostream>
 #include <string>
+#include <vector>
 
 using namespace llvm;
 using namespace klee;
@@ -151,6 +154,72 @@ InstructionInfoTable::InstructionInfoTable(Module *m)
   }
 }
 
+InstructionInfoTable::InstructionInfoTable()
+  : dummyString(""), dummyInfo(0, dummyString, 0, 0) {
+}
+
+void InstructionInfoTable::write(Module *m, std::ostream &os) const {
+  std::map<const std::string*, unsigned> fileIds;
+  fileIds[&dummyString] = 0;
+  os << internedStrings.size() << "\n";
+  for (std::set<const std::string *, ltstr>::const_iterator
+         it = internedStrings.begin(), ie = internedStrings.end();
+       it != ie; ++it) {
+    unsigned id = fileIds.size();
+    fileIds[*it] = id;
+    os << **it << "\n";
+  }
+
+  // Instructions are written in module order, so ids need not be.
+  os << infos.size() << "\n";
+  for (Module::iterator fnIt = m->begin(), fn_ie = m->end();
+       fnIt != fn_ie; ++fnIt) {
+    for (inst_iterator it = inst_begin(fnIt), ie = inst_end(fnIt); it != ie;
+         ++it) {
+      const InstructionInfo &info = getInfo(&*it);
+      os << fileIds[&info.file] << " " << info.line << " "
+         << info.assemblyLine << "\n";
+    }
+  }
+}
+
+InstructionInfoTable *InstructionInfoTable::read(Module *m,
+                                                 std::istream &is) {
+  InstructionInfoTable *table = new InstructionInfoTable();
+
+  unsigned numFiles;
+  is >> numFiles;
+  is.ignore(1);
+  std::vector<const std::string*> files(1, &table->dummyString);
+  for (unsigned i = 0; i != numFiles && is; ++i) {
+    std::string file;
+    std::getline(is, file);
+    files.push_back(table->internString(file));
+  }
+
+  unsigned numInstructions, id = 0;
+  is >> numInstructions;
+  for (Module::iterator fnIt = m->begin(), fn_ie = m->end();
+       fnIt != fn_ie && is; ++fnIt) {
+    for (inst_iterator it = inst_begin(fnIt), ie = inst_end(fnIt); it != ie;
+         ++it) {
+      unsigned file, line, assemblyLine;
+      if (!(is >> file >> line >> assemblyLine) || file >= files.size())
+        break;
+      table->infos.insert(std::make_pair(&*it,
+                                         InstructionInfo(id++, *files[file],
+                                                         line,
+                                                         assemblyLine)));
+    }
+  }
+
+  if (!is || id != numInstructions || table->infos.size() != id) {
+    delete table;
+    return 0;
+  }
+  return table;
+}
+
 InstructionInfoTable::~InstructionInfoTable() {
   for (std::set<const std::string *, ltstr>::iterator
          it = internedStrings.begin(), ie = internedStrings.end();
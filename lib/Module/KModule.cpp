@@ -16,6 +16,7 @@
 #include "Passes.h"
 
 #include "klee/Config/Version.h"
+#include "klee/Expr.h"
 #include "klee/Interpreter.h"
 #include "klee/Internal/Module/Cell.h"
 #include "klee/Internal/Module/KInstruction.h"
@@ -49,8 +50,10 @@
 #include "llvm/IR/CallSite.h"
 #endif
 
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/PassManager.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Support/Path.h"
@@ -58,8 +61,12 @@
 
 #include <llvm/Transforms/Utils/Cloning.h>
 
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 
+#include <unistd.h>
+
 using namespace llvm;
 using namespace klee;
 
@@ -101,6 +108,10 @@ namespace {
   cl::opt<bool>
   DebugPrintEscapingFunctions("debug-print-escaping-functions", 
                               cl::desc("Print functions whose address is taken."));
+
+  cl::opt<std::string>
+  PreparedModuleCache("prepared-module-cache",
+                      cl::desc("Directory in which to cache prepared modules, keyed by the content of the module and intrinsic library and by the options used to prepare them"));
 }
 
 KModule::KModule(Module *_module) 
@@ -111,12 +122,10 @@ KModule::KModule(Module *_module)
     targetData(new DataLayout(module)),
 #endif
     kleeMergeFn(0),
-    infos(0),
-    constantTable(0) {
+    infos(0) {
 }
 
 KModule::~KModule() {
-  delete[] constantTable;
   delete infos;
 
   for (std::vector<KFunction*>::iterator it = functions.begin(), 
@@ -135,6 +144,7 @@ KModule::~KModule() {
 
 namespace llvm {
 extern void Optimize(Module*);
+extern std::string getOptimizeSettings();
 }
 
 // what a hack
@@ -241,8 +251,167 @@ void KModule::addInternalFunction(const char* functionName){
   internalFunctions.insert(internalFunction);
 }
 
-void KModule::prepare(const Interpreter::ModuleOptions &opts,
-                      InterpreterHandler *ih) {
+/// Append \arg data to the 64-bit FNV-1a hash \arg hash.
+static uint64_t hashBytes(uint64_t hash, const std::string &data) {
+  for (std::string::const_iterator it = data.begin(), ie = data.end();
+       it != ie; ++it) {
+    hash ^= (unsigned char) *it;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static bool readFile(const std::string &path, std::string &contents) {
+  std::ifstream f(path.c_str(), std::ios::in | std::ios::binary);
+  if (!f)
+    return false;
+  std::ostringstream ss;
+  ss << f.rdbuf();
+  contents = ss.str();
+  return true;
+}
+
+/// Write \arg contents to \arg path through a temporary file, so that
+/// concurrent runs sharing the cache never see a partial file.
+static void writeFile(const std::string &path, const std::string &contents) {
+  std::string tmp = path + ".tmp" + llvm::utostr(getpid());
+  std::ofstream f(tmp.c_str(), std::ios::out | std::ios::binary);
+  f.write(contents.data(), contents.size());
+  f.close();
+  if (!f || rename(tmp.c_str(), path.c_str())) {
+    klee_warning("unable to write to prepared module cache: %s",
+                 path.c_str());
+    unlink(tmp.c_str());
+  }
+}
+
+static Module *readBitcode(const std::string &bitcode) {
+  MemoryBuffer *buffer = MemoryBuffer::getMemBuffer(bitcode, "", false);
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+  Module *m = ParseBitcodeFile(buffer, getGlobalContext());
+#else
+  ErrorOr<Module*> result = parseBitcodeFile(buffer, getGlobalContext());
+  Module *m = result ? *result : 0;
+#endif
+  delete buffer;
+  return m;
+}
+
+/// Truncate lines of \arg assembly to work around a kcachegrind parsing
+/// bug (it puts long lines on new lines), so that source browsing works.
+static std::string truncateSourceLines(const std::string &assembly) {
+  std::string result;
+  const char *position = assembly.c_str();
+
+  for (;;) {
+    const char *end = index(position, '\n');
+    if (!end) {
+      result += position;
+      break;
+    } else {
+      unsigned count = (end - position) + 1;
+      if (count<255) {
+        result.append(position, count);
+      } else {
+        result.append(position, 254);
+        result += "\n";
+      }
+      position = end+1;
+    }
+  }
+  return result;
+}
+
+std::string KModule::getIntrinsicLibraryPath(
+    const Interpreter::ModuleOptions &opts) {
+  SmallString<128> LibPath(opts.LibraryDir);
+  llvm::sys::path::append(LibPath,
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3,3)
+      "kleeRuntimeIntrinsic.bc"
+#else
+      "libkleeRuntimeIntrinsic.bca"
+#endif
+    );
+  return LibPath.str();
+}
+
+std::string KModule::getCachePath(const Interpreter::ModuleOptions &opts) {
+  std::string bitcode;
+  llvm::raw_string_ostream bos(bitcode);
+  WriteBitcodeToFile(module, bos);
+  bos.flush();
+
+  std::string library;
+  readFile(getIntrinsicLibraryPath(opts), library);
+
+  // Everything else which changes the prepared module or the side tables.
+  std::string settings;
+  llvm::raw_string_ostream sos(settings);
+  sos << "llvm=" << LLVM_VERSION_CODE
+      << " divzero=" << opts.CheckDivZero
+      << " overshift=" << opts.CheckOvershift
+      << " switch=" << (unsigned) SwitchType
+      << " truncate=" << !NoTruncateSourceLines;
+  if (opts.Optimize)
+    sos << " " << getOptimizeSettings();
+  for (cl::list<std::string>::iterator it = MergeAtExit.begin(),
+         ie = MergeAtExit.end(); it != ie; ++it)
+    sos << " merge=" << *it;
+  sos.flush();
+
+  uint64_t hash = 14695981039346656037ULL;
+  hash = hashBytes(hash, bitcode);
+  hash = hashBytes(hash, library);
+  hash = hashBytes(hash, settings);
+
+  char key[17];
+  snprintf(key, sizeof(key), "%016llx", (unsigned long long) hash);
+  SmallString<128> path(PreparedModuleCache);
+  llvm::sys::path::append(path, key);
+  return path.str();
+}
+
+bool KModule::loadFromCache(const std::string &path, std::string &assembly) {
+  std::string bitcode, table;
+  if (!readFile(path + ".bc", bitcode) || !readFile(path + ".info", table))
+    return false;
+  if (OutputSource && !readFile(path + ".ll", assembly))
+    return false;
+
+  Module *cached = readBitcode(bitcode);
+  if (!cached)
+    return false;
+
+  std::istringstream is(table);
+  infos = InstructionInfoTable::read(cached, is);
+  if (!infos) {
+    delete cached;
+    return false;
+  }
+
+  delete module;
+  module = cached;
+  return true;
+}
+
+void KModule::saveToCache(const std::string &path,
+                          const std::string &assembly) {
+  std::string bitcode;
+  llvm::raw_string_ostream bos(bitcode);
+  WriteBitcodeToFile(module, bos);
+  bos.flush();
+
+  std::ostringstream table;
+  infos->write(module, table);
+
+  // The bitcode goes last, as its presence is checked first.
+  if (OutputSource)
+    writeFile(path + ".ll", assembly);
+  writeFile(path + ".info", table.str());
+  writeFile(path + ".bc", bitcode);
+}
+
+void KModule::transform(const Interpreter::ModuleOptions &opts) {
   if (!MergeAtExit.empty()) {
     Function *mergeFn = module->getFunction("klee_merge");
     if (!mergeFn) {
@@ -339,23 +508,7 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   // this to be linked in, it makes low level debugging much more
   // annoying.
 
-  SmallString<128> LibPath(opts.LibraryDir);
-  llvm::sys::path::append(LibPath,
-#if LLVM_VERSION_CODE >= LLVM_VERSION(3,3)
-      "kleeRuntimeIntrinsic.bc"
-#else
-      "libkleeRuntimeIntrinsic.bca"
-#endif
-    );
-  module = linkWithLibrary(module, LibPath.str());
-
-  // Add internal functions which are not used to check if instructions
-  // have been already visited
-  if (opts.CheckDivZero)
-    addInternalFunction("klee_div_zero_check");
-  if (opts.CheckOvershift)
-    addInternalFunction("klee_overshift_check");
-
+  module = linkWithLibrary(module, getIntrinsicLibraryPath(opts));
 
   // Needs to happen after linking (since ctors/dtors can be modified)
   // and optimization (since global optimization can rewrite lists).
@@ -388,42 +541,49 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   f = module->getFunction("memset");
   if (f && f->use_empty()) f->eraseFromParent();
 #endif
+}
 
-  // Write out the .ll assembly file. We truncate long lines to work
-  // around a kcachegrind parsing bug (it puts them on new lines), so
-  // that source browsing works.
-  if (OutputSource) {
-    llvm::raw_fd_ostream *os = ih->openOutputFile("assembly.ll");
-    assert(os && !os->has_error() && "unable to open source output");
+void KModule::prepare(const Interpreter::ModuleOptions &opts,
+                      InterpreterHandler *ih) {
+  std::string cachePath, assembly;
+  bool cached = false;
+  if (!PreparedModuleCache.empty()) {
+    cachePath = getCachePath(opts);
+    cached = loadFromCache(cachePath, assembly);
+    if (cached)
+      klee_message("using cached prepared module %s.bc", cachePath.c_str());
+  }
 
-    // We have an option for this in case the user wants a .ll they
-    // can compile.
-    if (NoTruncateSourceLines) {
-      *os << *module;
-    } else {
-      std::string string;
-      llvm::raw_string_ostream rss(string);
+  if (!cached) {
+    transform(opts);
+
+    infos = new InstructionInfoTable(module);
+
+    if (OutputSource) {
+      llvm::raw_string_ostream rss(assembly);
       rss << *module;
       rss.flush();
-      const char *position = string.c_str();
-
-      for (;;) {
-        const char *end = index(position, '\n');
-        if (!end) {
-          *os << position;
-          break;
-        } else {
-          unsigned count = (end - position) + 1;
-          if (count<255) {
-            os->write(position, count);
-          } else {
-            os->write(position, 254);
-            *os << "\n";
-          }
-          position = end+1;
-        }
-      }
+      if (!NoTruncateSourceLines)
+        assembly = truncateSourceLines(assembly);
     }
+
+    if (!cachePath.empty())
+      saveToCache(cachePath, assembly);
+  }
+
+  // Add internal functions which are not used to check if instructions
+  // have been already visited
+  if (opts.CheckDivZero)
+    addInternalFunction("klee_div_zero_check");
+  if (opts.CheckOvershift)
+    addInternalFunction("klee_overshift_check");
+
+  // Write out the .ll assembly file. We have an option to not truncate
+  // long lines in case the user wants a .ll they can compile.
+  if (OutputSource) {
+    llvm::raw_fd_ostream *os = ih->openOutputFile("assembly.ll");
+    assert(os && !os->has_error() && "unable to open source output");
+    *os << assembly;
     delete os;
   }
 
@@ -435,33 +595,14 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
 
   kleeMergeFn = module->getFunction("klee_merge");
 
-  /* Build shadow structures */
+  /* Compute various interesting properties */
 
-  infos = new InstructionInfoTable(module);  
-  
+  // Shadow structures are only built for the functions which are called,
+  // most of the runtime usually is not.
   for (Module::iterator it = module->begin(), ie = module->end();
        it != ie; ++it) {
-    if (it->isDeclaration())
-      continue;
-
-    KFunction *kf = new KFunction(it, this);
-    
-    for (unsigned i=0; i<kf->numInstructions; ++i) {
-      KInstruction *ki = kf->instructions[i];
-      ki->info = &infos->getInfo(ki->inst);
-    }
-
-    functions.push_back(kf);
-    functionMap.insert(std::make_pair(it, kf));
-  }
-
-  /* Compute various interesting properties */
-
-  for (std::vector<KFunction*>::iterator it = functions.begin(), 
-         ie = functions.end(); it != ie; ++it) {
-    KFunction *kf = *it;
-    if (functionEscapes(kf->function))
-      escapingFunctions.insert(kf->function);
+    if (!it->isDeclaration() && functionEscapes(it))
+      escapingFunctions.insert(it);
   }
 
   if (DebugPrintEscapingFunctions && !escapingFunctions.empty()) {
@@ -474,6 +615,21 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   }
 }
 
+KFunction *KModule::buildKFunction(Function *f) {
+  assert(!f->isDeclaration() && !functionMap.count(f) &&
+         "invalid function to build");
+  KFunction *kf = new KFunction(f, this);
+
+  for (unsigned i=0; i<kf->numInstructions; ++i) {
+    KInstruction *ki = kf->instructions[i];
+    ki->info = &infos->getInfo(ki->inst);
+  }
+
+  functions.push_back(kf);
+  functionMap.insert(std::make_pair(f, kf));
+  return kf;
+}
+
 KConstant* KModule::getKConstant(Constant *c) {
   std::map<llvm::Constant*, KConstant*>::iterator it = constantMap.find(c);
   if (it != constantMap.end())
@@ -521,6 +677,61 @@ static int getOperandNum(Value *v,
   }
 }
 
+static ref<Expr> truncate(const ref<Expr> &e, Expr::Width width) {
+  return ExtractExpr::create(e, 0, width);
+}
+
+/// Fill in the pre-decoded form of \arg ki, see KInstruction::binaryOp.
+static void decodeInstruction(KInstruction *ki, KModule *km) {
+  Instruction *inst = ki->inst;
+  ki->binaryOp = 0;
+  ki->castOp = 0;
+  ki->width = 0;
+
+  switch (inst->getOpcode()) {
+  case Instruction::Add: ki->binaryOp = AddExpr::create; break;
+  case Instruction::Sub: ki->binaryOp = SubExpr::create; break;
+  case Instruction::Mul: ki->binaryOp = MulExpr::create; break;
+  case Instruction::UDiv: ki->binaryOp = UDivExpr::create; break;
+  case Instruction::SDiv: ki->binaryOp = SDivExpr::create; break;
+  case Instruction::URem: ki->binaryOp = URemExpr::create; break;
+  case Instruction::SRem: ki->binaryOp = SRemExpr::create; break;
+  case Instruction::And: ki->binaryOp = AndExpr::create; break;
+  case Instruction::Or: ki->binaryOp = OrExpr::create; break;
+  case Instruction::Xor: ki->binaryOp = XorExpr::create; break;
+  case Instruction::Shl: ki->binaryOp = ShlExpr::create; break;
+  case Instruction::LShr: ki->binaryOp = LShrExpr::create; break;
+  case Instruction::AShr: ki->binaryOp = AShrExpr::create; break;
+
+  case Instruction::ICmp:
+    switch (cast<ICmpInst>(inst)->getPredicate()) {
+    case ICmpInst::ICMP_EQ: ki->binaryOp = EqExpr::create; break;
+    case ICmpInst::ICMP_NE: ki->binaryOp = NeExpr::create; break;
+    case ICmpInst::ICMP_UGT: ki->binaryOp = UgtExpr::create; break;
+    case ICmpInst::ICMP_UGE: ki->binaryOp = UgeExpr::create; break;
+    case ICmpInst::ICMP_ULT: ki->binaryOp = UltExpr::create; break;
+    case ICmpInst::ICMP_ULE: ki->binaryOp = UleExpr::create; break;
+    case ICmpInst::ICMP_SGT: ki->binaryOp = SgtExpr::create; break;
+    case ICmpInst::ICMP_SGE: ki->binaryOp = SgeExpr::create; break;
+    case ICmpInst::ICMP_SLT: ki->binaryOp = SltExpr::create; break;
+    case ICmpInst::ICMP_SLE: ki->binaryOp = SleExpr::create; break;
+    default: break;
+    }
+    break;
+
+  case Instruction::Trunc: ki->castOp = truncate; break;
+  case Instruction::ZExt:
+  case Instruction::IntToPtr:
+  case Instruction::PtrToInt: ki->castOp = ZExtExpr::create; break;
+  case Instruction::SExt: ki->castOp = SExtExpr::create; break;
+
+  default: break;
+  }
+
+  if (ki->castOp)
+    ki->width = km->targetData->getTypeSizeInBits(inst->getType());
+}
+
 KFunction::KFunction(llvm::Function *_function,
                      KModule *km) 
   : function(_function),
@@ -560,6 +771,8 @@ KFunction::KFunction(llvm::Function *_function,
       case Instruction::InsertValue:
       case Instruction::ExtractValue:
         ki = new KGEPInstruction(); break;
+      case Instruction::Br:
+        ki = new KBranchInstruction(); break;
       default:
         ki = new KInstruction(); break;
       }
@@ -586,6 +799,22 @@ KFunction::KFunction(llvm::Function *_function,
         }
       }
 
+      decodeInstruction(ki, km);
+
+      if (BranchInst *bi = dyn_cast<BranchInst>(it)) {
+        KBranchInstruction *kbi = static_cast<KBranchInstruction*>(ki);
+        for (unsigned j = 0; j != 2; ++j) {
+          kbi->targets[j] = 0;
+          kbi->incoming[j] = -1;
+          if (j >= bi->getNumSuccessors())
+            continue;
+          BasicBlock *dst = bi->getSuccessor(j);
+          kbi->targets[j] = basicBlockEntry[dst];
+          if (PHINode *first = dyn_cast<PHINode>(dst->begin()))
+            kbi->incoming[j] = first->getBasicBlockIndex(bbit);
+        }
+      }
+
       instructions[i++] = ki;
     }
   }
@@ -44,6 +44,7 @@
 #include "llvm/Transforms/IPO.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Support/PluginLoader.h"
+#include "llvm/Support/raw_ostream.h"
 using namespace llvm;
 
 // Don't verify at the end
@@ -294,4 +295,17 @@ void Optimize(Module* M) {
   Passes.run(*M);
 }
 
+/// getOptimizeSettings - Return a string identifying the options Optimize
+/// runs with, so that modules it produced can be cached.
+std::string getOptimizeSettings() {
+  std::string settings;
+  raw_string_ostream os(settings);
+  os << "inline=" << !DisableInline
+     << " opt=" << !DisableOptimizations
+     << " internalize=" << !DisableInternalize
+     << " strip=" << Strip
+     << " strip-debug=" << StripDebug;
+  return os.str();
+}
+
 }
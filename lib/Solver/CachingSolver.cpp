@@ -14,6 +14,7 @@
 #include "klee/Expr.h"
 #include "klee/IncompleteSolver.h"
 #include "klee/SolverImpl.h"
+#include "klee/util/Assignment.h"
 
 #include "SolverStats.h"
 
@@ -38,6 +39,18 @@ private:
 
   bool cacheLookup(const Query& query,
                    IncompleteSolver::PartialValidity &result);
+
+  bool valueCacheLookup(const Query& query, ref<Expr> &result);
+
+  bool modelCacheLookup(const Query& query,
+                        const std::vector<const Array*> &objects,
+                        std::vector< std::vector<unsigned char> > &values,
+                        bool &hasSolution);
+
+  void modelCacheInsert(const Query& query,
+                        const std::vector<const Array*> &objects,
+                        std::vector< std::vector<unsigned char> > &values,
+                        bool hasSolution);
   
   struct CacheEntry {
     CacheEntry(const ConstraintManager &c, ref<Expr> q)
@@ -66,36 +79,52 @@ private:
     }
   };
 
+  /// A model previously computed for a query. A null assignment
+  /// records that the query has no solution.
+  struct CachedModel {
+    CachedModel() : assignment(0) {}
+    explicit CachedModel(Assignment *a) : assignment(a) {}
+
+    Assignment *assignment;
+  };
+
   typedef unordered_map<CacheEntry, 
                         IncompleteSolver::PartialValidity, 
                         CacheEntryHash> cache_map;
+  typedef unordered_map<CacheEntry, ref<Expr>, CacheEntryHash> value_map;
+  typedef unordered_map<CacheEntry, CachedModel, CacheEntryHash> model_map;
   
   Solver *solver;
   cache_map cache;
+  value_map valueCache;
+  model_map modelCache;
 
 public:
   CachingSolver(Solver *s) : solver(s) {}
-  ~CachingSolver() { cache.clear(); delete solver; }
+  ~CachingSolver();
 
   bool computeValidity(const Query&, Solver::Validity &result);
   bool computeTruth(const Query&, bool &isValid);
-  bool computeValue(const Query& query, ref<Expr> &result) {
-    ++stats::queryCacheMisses;
-    return solver->impl->computeValue(query, result);
-  }
+  bool computeValue(const Query& query, ref<Expr> &result);
   bool computeInitialValues(const Query& query,
                             const std::vector<const Array*> &objects,
                             std::vector< std::vector<unsigned char> > &values,
-                            bool &hasSolution) {
-    ++stats::queryCacheMisses;
-    return solver->impl->computeInitialValues(query, objects, values, 
-                                              hasSolution);
-  }
+                            bool &hasSolution);
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query&);
   void setCoreSolverTimeout(double timeout);
 };
 
+CachingSolver::~CachingSolver() {
+  cache.clear();
+  valueCache.clear();
+  for (model_map::iterator it = modelCache.begin(), ie = modelCache.end();
+       it != ie; ++it)
+    delete it->second.assignment;
+  modelCache.clear();
+  delete solver;
+}
+
 /** @returns the canonical version of the given query.  The reference
     negationUsed is set to true if the original query was negated in
     the canonicalization process. */
@@ -249,6 +278,146 @@ bool CachingSolver::computeTruth(const Query& query,
   return true;
 }
 
+/// Check whether \arg a is a model for \arg query, i.e. it satisfies all of
+/// the constraints and falsifies the query expression. Objects which are not
+/// bound by the assignment evaluate to zero.
+static bool isModelFor(Assignment &a, const Query &query) {
+  for (ConstraintManager::constraint_iterator it = query.constraints.begin(),
+         ie = query.constraints.end(); it != ie; ++it) {
+    ref<Expr> res = a.evaluate(*it);
+    if (!isa<ConstantExpr>(res) || !cast<ConstantExpr>(res)->isTrue())
+      return false;
+  }
+  ref<Expr> res = a.evaluate(query.expr);
+  return isa<ConstantExpr>(res) && cast<ConstantExpr>(res)->isFalse();
+}
+
+/** @returns true on a cache hit, false on a cache miss. A value is
+    served either from an identical previous getValue query, or by
+    evaluating the expression under a cached model of the constraints
+    which still satisfies them. */
+bool CachingSolver::valueCacheLookup(const Query& query, ref<Expr> &result) {
+  value_map::iterator it = valueCache.find(CacheEntry(query.constraints,
+                                                      query.expr));
+  if (it != valueCache.end()) {
+    result = it->second;
+    return true;
+  }
+
+  model_map::iterator mit =
+    modelCache.find(CacheEntry(query.constraints,
+                               ConstantExpr::alloc(0, Expr::Bool)));
+  if (mit == modelCache.end() || !mit->second.assignment)
+    return false;
+
+  Assignment &a = *mit->second.assignment;
+  if (!isModelFor(a, query.withFalse()))
+    return false;
+
+  ref<Expr> value = a.evaluate(query.expr);
+  if (!isa<ConstantExpr>(value))
+    return false;
+
+  result = value;
+  valueCache.insert(std::make_pair(CacheEntry(query.constraints, query.expr),
+                                   result));
+  return true;
+}
+
+bool CachingSolver::computeValue(const Query& query, ref<Expr> &result) {
+  if (valueCacheLookup(query, result)) {
+    ++stats::queryCacheHits;
+    return true;
+  }
+
+  ++stats::queryCacheMisses;
+
+  if (!solver->impl->computeValue(query, result))
+    return false;
+
+  valueCache.insert(std::make_pair(CacheEntry(query.constraints, query.expr),
+                                   result));
+  return true;
+}
+
+/** @returns true on a cache hit, false on a cache miss. A cached model
+    is reused directly when it binds all requested objects; otherwise it
+    is only reused if it still evaluates to a model of the query. */
+bool 
+CachingSolver::modelCacheLookup(const Query& query,
+                                const std::vector<const Array*> &objects,
+                                std::vector< std::vector<unsigned char> >
+                                  &values,
+                                bool &hasSolution) {
+  model_map::iterator it = modelCache.find(CacheEntry(query.constraints,
+                                                      query.expr));
+  if (it == modelCache.end())
+    return false;
+
+  Assignment *a = it->second.assignment;
+  if (!a) {
+    hasSolution = false;
+    return true;
+  }
+
+  bool complete = true;
+  for (std::vector<const Array*>::const_iterator oi = objects.begin(),
+         oe = objects.end(); oi != oe; ++oi) {
+    if (!a->bindings.count(*oi)) {
+      complete = false;
+      break;
+    }
+  }
+  if (!complete && !isModelFor(*a, query))
+    return false;
+
+  hasSolution = true;
+  values = std::vector< std::vector<unsigned char> >(objects.size());
+  for (unsigned i = 0; i < objects.size(); ++i) {
+    const Array *os = objects[i];
+    Assignment::bindings_ty::iterator bi = a->bindings.find(os);
+    if (bi == a->bindings.end())
+      values[i] = std::vector<unsigned char>(os->size, 0);
+    else
+      values[i] = bi->second;
+  }
+  return true;
+}
+
+/// Inserts the given query, model pair into the cache, replacing any
+/// previously cached model for the query.
+void 
+CachingSolver::modelCacheInsert(const Query& query,
+                                const std::vector<const Array*> &objects,
+                                std::vector< std::vector<unsigned char> >
+                                  &values,
+                                bool hasSolution) {
+  CachedModel &entry = modelCache[CacheEntry(query.constraints, query.expr)];
+  delete entry.assignment;
+  entry.assignment = hasSolution ? new Assignment(objects, values) : 0;
+}
+
+bool 
+CachingSolver::computeInitialValues(const Query& query,
+                                    const std::vector<const Array*> &objects,
+                                    std::vector< std::vector<unsigned char> >
+                                      &values,
+                                    bool &hasSolution) {
+  if (modelCacheLookup(query, objects, values, hasSolution)) {
+    ++stats::queryCacheHits;
+    return true;
+  }
+
+  ++stats::queryCacheMisses;
+
+  if (!solver->impl->computeInitialValues(query, objects, values,
+                                          hasSolution))
+    return false;
+
+  modelCacheInsert(query, objects, values, hasSolution);
+  return true;
+}
+
 SolverImpl::SolverRunStatus CachingSolver::getOperationStatusCode() {
   return solver->impl->getOperationStatusCode();
 }
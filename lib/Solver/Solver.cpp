@@ -174,6 +174,100 @@ bool Solver::mayBeFalse(const Query& query, bool &result) {
   return true;
 }
 
+bool Solver::mayBeTrue(const ConstraintManager &constraints,
+                       const std::vector< ref<Expr> > &exprs,
+                       std::vector<bool> &results) {
+  results.assign(exprs.size(), false);
+
+  std::vector<unsigned> pending;
+  for (unsigned i = 0, e = exprs.size(); i != e; ++i) {
+    assert(exprs[i]->getWidth() == Expr::Bool && "Invalid expression type!");
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(exprs[i]))
+      results[i] = CE->isTrue();
+    else
+      pending.push_back(i);
+  }
+
+  // Nothing to share for a single expression.
+  if (pending.size() <= 1) {
+    if (pending.empty())
+      return true;
+    bool res;
+    if (!mayBeTrue(Query(constraints, exprs[pending[0]]), res))
+      return false;
+    results[pending[0]] = res;
+    return true;
+  }
+
+  std::vector< ref<Expr> > all(constraints.begin(), constraints.end());
+  for (std::vector<unsigned>::iterator it = pending.begin(),
+         ie = pending.end(); it != ie; ++it)
+    all.push_back(exprs[*it]);
+  std::vector<const Array*> objects;
+  findSymbolicObjects(all.begin(), all.end(), objects);
+
+  while (!pending.empty()) {
+    ref<Expr> any = ConstantExpr::alloc(0, Expr::Bool);
+    for (std::vector<unsigned>::iterator it = pending.begin(),
+           ie = pending.end(); it != ie; ++it)
+      any = OrExpr::create(exprs[*it], any);
+
+    // Ask for an assignment satisfying at least one pending expression.
+    std::vector< std::vector<unsigned char> > values;
+    bool hasSolution;
+    if (!impl->computeInitialValues(Query(constraints,
+                                          Expr::createIsZero(any)),
+                                    objects, values, hasSolution))
+      return false;
+    if (!hasSolution)
+      return true;
+
+    Assignment assignment(objects, values);
+    std::vector<unsigned> remaining;
+    for (std::vector<unsigned>::iterator it = pending.begin(),
+           ie = pending.end(); it != ie; ++it) {
+      ref<Expr> value = assignment.evaluate(exprs[*it]);
+      if (isa<ConstantExpr>(value) && cast<ConstantExpr>(value)->isTrue())
+        results[*it] = true;
+      else
+        remaining.push_back(*it);
+    }
+
+    // The assignment must satisfy one of the expressions; if it does not,
+    // fall back to asking about each expression separately.
+    if (remaining.size() == pending.size()) {
+      for (std::vector<unsigned>::iterator it = remaining.begin(),
+             ie = remaining.end(); it != ie; ++it) {
+        bool res;
+        if (!mayBeTrue(Query(constraints, exprs[*it]), res))
+          return false;
+        results[*it] = res;
+      }
+      return true;
+    }
+
+    pending.swap(remaining);
+  }
+
+  return true;
+}
+
+bool Solver::mustBeTrue(const ConstraintManager &constraints,
+                        const std::vector< ref<Expr> > &exprs,
+                        std::vector<bool> &results) {
+  std::vector< ref<Expr> > negated;
+  negated.reserve(exprs.size());
+  for (std::vector< ref<Expr> >::const_iterator it = exprs.begin(),
+         ie = exprs.end(); it != ie; ++it)
+    negated.push_back(Expr::createIsZero(*it));
+
+  if (!mayBeTrue(constraints, negated, results))
+    return false;
+
+  results.flip();
+  return true;
+}
+
 bool Solver::getValue(const Query& query, ref<ConstantExpr> &result) {
   // Maintain invariants implementation expect.
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr)) {
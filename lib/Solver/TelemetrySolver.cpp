@@ -0,0 +1,233 @@
+//===-- TelemetrySolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/SolverImpl.h"
+#include "klee/Internal/System/Time.h"
+
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <list>
+#include <string>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+
+  /// Histogram - Counts of values in power of two buckets; bucket 0 holds
+  /// zero and bucket i > 0 holds values in [2^(i-1), 2^i).
+  class Histogram {
+    static const unsigned NumBuckets = 65;
+    uint64_t buckets[NumBuckets];
+
+  public:
+    Histogram() {
+      for (unsigned i = 0; i != NumBuckets; ++i)
+        buckets[i] = 0;
+    }
+
+    void add(uint64_t value) {
+      ++buckets[value ? Log2_64(value) + 1 : 0];
+    }
+
+    void print(raw_ostream &os, const char *unit) const {
+      for (unsigned i = 0; i != NumBuckets; ++i) {
+        if (!buckets[i])
+          continue;
+        uint64_t lo = i ? 1ULL << (i - 1) : 0;
+        os << "    [" << lo << ", ";
+        if (i == NumBuckets - 1)
+          os << "inf";
+        else
+          os << (1ULL << i);
+        os << ") " << unit << ": " << buckets[i] << "\n";
+      }
+    }
+  };
+
+  /// LayerTelemetry - The measurements recorded for one layer of a
+  /// solver chain. Times include the time spent in the layers below.
+  struct LayerTelemetry {
+    std::string name;
+    /// Whether no instrumented layer is below this one, so hits are not
+    /// counted.
+    bool innermost;
+    uint64_t queries;
+    uint64_t truthQueries, validityQueries, valueQueries,
+      initialValuesQueries;
+    /// Queries answered without reaching the next instrumented layer.
+    uint64_t hits;
+    uint64_t failures;
+    uint64_t timeouts;
+    double time;
+    Histogram latency;
+    Histogram constraints;
+
+    LayerTelemetry(const std::string &_name, bool _innermost)
+      : name(_name), innermost(_innermost), queries(0), truthQueries(0), validityQueries(0),
+        valueQueries(0), initialValuesQueries(0), hits(0), failures(0),
+        timeouts(0), time(0.) {}
+  };
+
+  /// The telemetry of every layer created so far, innermost layers first.
+  /// Entries outlive their solvers so the report can be written at exit.
+  std::list<LayerTelemetry> &getLayers() {
+    static std::list<LayerTelemetry> layers;
+    return layers;
+  }
+
+  /// The number of queries which have entered any instrumented layer, used
+  /// to detect whether a layer forwarded a query.
+  uint64_t instrumentedQueries = 0;
+}
+
+class TelemetrySolver : public SolverImpl {
+private:
+  Solver *solver;
+  LayerTelemetry &telemetry;
+
+  uint64_t startQuery(const Query &query, uint64_t &kindCount);
+  bool finishQuery(bool success, uint64_t entered, double start);
+
+public:
+  TelemetrySolver(Solver *_solver, LayerTelemetry &_telemetry)
+    : solver(_solver), telemetry(_telemetry) {}
+  ~TelemetrySolver() { delete solver; }
+
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValidity(const Query&, Solver::Validity &result);
+  bool computeValue(const Query&, ref<Expr> &result);
+  bool computeInitialValues(const Query& query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query&);
+  void setCoreSolverTimeout(double timeout);
+};
+
+uint64_t TelemetrySolver::startQuery(const Query &query,
+                                     uint64_t &kindCount) {
+  ++telemetry.queries;
+  ++kindCount;
+  telemetry.constraints.add(query.constraints.size());
+  return ++instrumentedQueries;
+}
+
+bool TelemetrySolver::finishQuery(bool success, uint64_t entered,
+                                  double start) {
+  double elapsed = util::getWallTime() - start;
+  telemetry.time += elapsed;
+  telemetry.latency.add((uint64_t) (elapsed * 1000000.));
+
+  if (!telemetry.innermost && instrumentedQueries == entered)
+    ++telemetry.hits;
+
+  if (!success) {
+    ++telemetry.failures;
+    if (solver->impl->getOperationStatusCode() == SOLVER_RUN_STATUS_TIMEOUT)
+      ++telemetry.timeouts;
+  }
+
+  return success;
+}
+
+bool TelemetrySolver::computeTruth(const Query& query, bool &isValid) {
+  uint64_t entered = startQuery(query, telemetry.truthQueries);
+  double start = util::getWallTime();
+  bool success = solver->impl->computeTruth(query, isValid);
+  return finishQuery(success, entered, start);
+}
+
+bool TelemetrySolver::computeValidity(const Query& query,
+                                      Solver::Validity &result) {
+  uint64_t entered = startQuery(query, telemetry.validityQueries);
+  double start = util::getWallTime();
+  bool success = solver->impl->computeValidity(query, result);
+  return finishQuery(success, entered, start);
+}
+
+bool TelemetrySolver::computeValue(const Query& query, ref<Expr> &result) {
+  uint64_t entered = startQuery(query, telemetry.valueQueries);
+  double start = util::getWallTime();
+  bool success = solver->impl->computeValue(query, result);
+  return finishQuery(success, entered, start);
+}
+
+bool TelemetrySolver::computeInitialValues(const Query& query,
+                                           const std::vector<const Array*>
+                                             &objects,
+                                           std::vector< std::vector<unsigned char> >
+                                             &values,
+                                           bool &hasSolution) {
+  uint64_t entered = startQuery(query, telemetry.initialValuesQueries);
+  double start = util::getWallTime();
+  bool success = solver->impl->computeInitialValues(query, objects, values,
+                                                    hasSolution);
+  return finishQuery(success, entered, start);
+}
+
+SolverImpl::SolverRunStatus TelemetrySolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *TelemetrySolver::getConstraintLog(const Query& query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void TelemetrySolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+Solver *klee::createTelemetrySolver(Solver *s, const std::string &name,
+                                    bool innermost) {
+  std::list<LayerTelemetry> &layers = getLayers();
+  layers.push_back(LayerTelemetry(name, innermost));
+  return new Solver(new TelemetrySolver(s, layers.back()));
+}
+
+static double ratio(uint64_t n, uint64_t d) {
+  return d ? (double) n / d : 0.;
+}
+
+void klee::writeSolverTelemetry(raw_ostream &os) {
+  std::list<LayerTelemetry> &layers = getLayers();
+
+  // Outermost layer first, in the order queries flow through the chain.
+  for (std::list<LayerTelemetry>::reverse_iterator it = layers.rbegin(),
+         ie = layers.rend(); it != ie; ++it) {
+    const LayerTelemetry &t = *it;
+    os << "layer: " << t.name << "\n"
+       << "  queries: " << t.queries
+       << " (truth: " << t.truthQueries
+       << ", validity: " << t.validityQueries
+       << ", value: " << t.valueQueries
+       << ", initial values: " << t.initialValuesQueries << ")\n";
+    // Every query of the innermost layer reaches the solver it wraps.
+    if (!t.innermost)
+      os << "  hits: " << t.hits << " (" << ratio(t.hits, t.queries) << ")\n"
+         << "  misses: " << t.queries - t.hits
+         << " (" << ratio(t.queries - t.hits, t.queries) << ")\n";
+    os << "  failures: " << t.failures
+       << " (" << ratio(t.failures, t.queries) << ")\n"
+       << "  timeouts: " << t.timeouts
+       << " (" << ratio(t.timeouts, t.queries) << ")\n"
+       << "  time (s): " << t.time << "\n"
+       << "  latency:\n";
+    t.latency.print(os, "us");
+    os << "  constraints:\n";
+    t.constraints.print(os, "constraints");
+    os << "\n";
+  }
+  os.flush();
+}
@@ -0,0 +1,35 @@
+// Check that memset, memcpy and memmove on large buffers are applied in
+// bulk with --accelerate-memory-intrinsics, keeping symbolic bytes. The
+// interpreted loops would exceed the instruction limit.
+
+// RUN: %llvmgcc -emit-llvm -g -c %s -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --accelerate-memory-intrinsics --stop-after-n-instructions=100000 %t.bc 2> %t.err
+// RUN: grep "completed paths = 2" %t.err
+// RUN: not grep "ASSERTION FAIL" %t.klee-out/messages.txt
+
+#include <assert.h>
+#include <string.h>
+
+#define N (1 << 20)
+
+char src[N], dst[N];
+
+int main() {
+  char c;
+
+  klee_make_symbolic(&c, sizeof c, "c");
+
+  memset(src, 'a', N);
+  src[100] = c;
+  memcpy(dst, src, N);
+  assert(dst[0] == 'a' && dst[N - 1] == 'a');
+
+  // Overlapping, the symbolic byte moves from 100 to 101.
+  memmove(dst + 1, dst, N - 1);
+  assert(dst[100] == 'a');
+
+  if (dst[101] == 'x')
+    return 1;
+  return 0;
+}
@@ -0,0 +1,22 @@
+// Check that --use-dynamic-merge does not merge states arriving at a PHI
+// node from different blocks, which would give one of them the wrong value.
+
+// RUN: %llvmgcc -emit-llvm -g -c %s -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-dynamic-merge --search=bfs %t.bc 2> %t.err
+// RUN: not grep "ASSERTION FAIL" %t.klee-out/messages.txt
+
+#include <assert.h>
+
+int main() {
+  int x = klee_int("x");
+
+  // The conditional operator joins in a block starting with a PHI node.
+  int c = x > 0 ? 1 : 2;
+
+  if (x > 0)
+    assert(c == 1);
+  else
+    assert(c == 2);
+  return 0;
+}
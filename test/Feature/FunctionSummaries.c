@@ -0,0 +1,42 @@
+// Check that calls with concrete inputs are summarized and reused across
+// states with --summarize-functions, without changing the paths explored,
+// also when states are retired and recreated.
+
+// RUN: %llvmgcc -emit-llvm -g -c %s -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=dfs --summarize-functions %t.bc 2> %t.err
+// RUN: grep "function summaries: 1 recorded, 7 reused" %t.err
+// RUN: grep "completed paths = 8" %t.err
+// RUN: rm -rf %t.klee-out2
+// RUN: %klee --output-dir=%t.klee-out2 --search=dfs --summarize-functions --max-resident-states=2 %t.bc 2> %t.err2
+// RUN: grep "completed paths = 8" %t.err2
+// RUN: not grep "ASSERTION FAIL" %t.klee-out2/messages.txt
+
+#include <assert.h>
+
+unsigned table[16];
+
+unsigned sum(unsigned n) {
+  unsigned i, s = 0;
+  for (i = 0; i < n; i++)
+    s += table[i];
+  return s;
+}
+
+int main() {
+  unsigned char buf[3];
+  unsigned i, x = 0;
+
+  for (i = 0; i < 16; i++)
+    table[i] = i;
+
+  klee_make_symbolic(buf, sizeof buf, "buf");
+
+  // 8 states
+  for (i = 0; i < 3; i++)
+    if (buf[i] > 100)
+      x |= 1 << i;
+
+  assert(sum(16) == 120);
+  return x;
+}
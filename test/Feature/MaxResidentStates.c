@@ -0,0 +1,32 @@
+// Check that states retired with --max-resident-states are recreated by
+// replaying their branches, and that every path still completes.
+
+// RUN: %llvmgcc -emit-llvm -g -c %s -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-resident-states=2 %t.bc 2> %t.err
+// RUN: grep "completed paths = 16" %t.err
+// RUN: not grep "were not recreated" %t.err
+// RUN: not grep "diverged from its recorded path" %t.err
+// RUN: ls %t.klee-out | grep ".ktest" | wc -l | grep 16
+// Merged states are never retired.
+// RUN: rm -rf %t.klee-out2
+// RUN: %klee --output-dir=%t.klee-out2 --max-resident-states=2 --use-dynamic-merge --search=bfs %t.bc 2> %t.err2
+// RUN: not grep "were not recreated" %t.err2
+// RUN: not grep "diverged from its recorded path" %t.err2
+
+int main() {
+  unsigned char buf[4];
+  unsigned i, x = 0;
+
+  klee_make_symbolic(buf, sizeof buf, "buf");
+
+  for (i = 0; i < 4; i++)
+    if (buf[i] > 100)
+      x |= 1 << i;
+
+  // Branches on concrete values are not recorded.
+  for (i = 0; i < 100; i++)
+    x += i & 1;
+
+  return x;
+}
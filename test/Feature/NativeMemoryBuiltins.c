@@ -0,0 +1,40 @@
+// Check that memory builtins on large buffers run natively with
+// --native-memory-builtins, keeping symbolic bytes and building
+// expressions instead of forking. The interpreted loops would exceed the
+// instruction limit.
+
+// RUN: %llvmgcc -emit-llvm -g -c %s -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --native-memory-builtins --stop-after-n-instructions=100000 %t.bc 2> %t.err
+// RUN: grep "completed paths = 2" %t.err
+// RUN: not grep "ASSERTION FAIL" %t.klee-out/messages.txt
+
+#include <assert.h>
+#include <string.h>
+
+#define N (1 << 20)
+
+char src[N], dst[N];
+
+int main() {
+  char c;
+
+  klee_make_symbolic(&c, sizeof c, "c");
+
+  // The last byte stays zero.
+  memset(src, 'a', N - 1);
+  src[100] = c;
+  memcpy(dst, src, N);
+  assert(dst[0] == 'a' && dst[N - 2] == 'a' && dst[N - 1] == 0);
+  assert(memcmp(dst, src, N) == 0);
+
+  // Overlapping, the symbolic byte moves from 100 to 101.
+  memmove(dst + 1, dst, N - 2);
+  assert(dst[100] == 'a' && dst[N - 1] == 0);
+
+  // Either ends at the symbolic byte or at the last one, without forking
+  // on the bytes in between.
+  if (strlen(dst) == 101)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,22 @@
+// Check that a second run on the same module with --prepared-module-cache
+// uses the cached prepared module, and explores the same paths.
+
+// RUN: %llvmgcc -emit-llvm -g -c %s -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out2 %t.cache
+// RUN: mkdir %t.cache
+// RUN: %klee --output-dir=%t.klee-out --prepared-module-cache=%t.cache %t.bc 2> %t.err
+// RUN: not grep "using cached prepared module" %t.err
+// RUN: grep "completed paths = 2" %t.err
+// RUN: %klee --output-dir=%t.klee-out2 --prepared-module-cache=%t.cache %t.bc 2> %t.err2
+// RUN: grep "using cached prepared module" %t.err2
+// RUN: grep "completed paths = 2" %t.err2
+// RUN: diff %t.klee-out/assembly.ll %t.klee-out2/assembly.ll
+
+int main() {
+  int x;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+  if (x > 10)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,33 @@
+// RUN: %llvmgcc -emit-llvm -g -c -o %t1.bc %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-range-facts %t1.bc 2> %t.log
+// RUN: grep "completed paths = 2" %t.log
+// The 19th column of run.stats is QueryRangeHits.
+// RUN: grep "'QueryRangeHits'" %t.klee-out/run.stats
+// RUN: tail -n 1 %t.klee-out/run.stats | cut -d, -f19 | grep "^[1-9]"
+// RUN: rm -rf %t.klee-out-off
+// RUN: %klee --output-dir=%t.klee-out-off --use-range-facts=false %t1.bc 2> %t.off.log
+// RUN: grep "completed paths = 2" %t.off.log
+// RUN: tail -n 1 %t.klee-out-off/run.stats | cut -d, -f19 | grep "^0"
+
+#include <assert.h>
+
+int main() {
+  unsigned char buf[16];
+  unsigned x = klee_int("x");
+  klee_assume(x > 3);
+  klee_assume(x < 12);
+  klee_assume(x != 4);
+
+  // decided by the range of x
+  if (x < 3 || x == 4 || x >= 12)
+    assert(0 && "unreachable");
+
+  // in bounds for every value of x
+  buf[x] = 1;
+  buf[x + 4] = 2;
+
+  if (x > 7)
+    return buf[x];
+  return 0;
+}
@@ -0,0 +1,32 @@
+// Check that the searcher updates recorded by --write-searcher-trace can be
+// replayed by klee-searcher-bench, and that the synthetic run works.
+
+// RUN: %llvmgcc -emit-llvm -g -c %s -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-searcher-trace %t.bc
+// RUN: grep "^a 1 0$" %t.klee-out/searcher.trace
+// RUN: grep -c "^r " %t.klee-out/searcher.trace | grep 8
+// RUN: klee-searcher-bench --searcher=dfs --searcher=random-path %t.klee-out/searcher.trace | FileCheck --check-prefix=CHECK-TRACE %s
+// RUN: klee-searcher-bench --searcher=nurs:depth --batch-steps=10 --synthetic-states=1000 --synthetic-steps=20000 | FileCheck --check-prefix=CHECK-SYNTHETIC %s
+
+// CHECK-TRACE: InterleavedSearcher
+// CHECK-TRACE: peak states: {{[1-8]}}
+// CHECK-TRACE: selectState:
+// CHECK-TRACE: update:
+
+// CHECK-SYNTHETIC: BatchingSearcher
+// CHECK-SYNTHETIC: steps: 20001
+// CHECK-SYNTHETIC: peak states: {{1[0-9][0-9][0-9]$}}
+
+int main() {
+  unsigned char buf[3];
+  unsigned i, x = 0;
+
+  klee_make_symbolic(buf, sizeof buf, "buf");
+
+  for (i = 0; i < 3; i++)
+    if (buf[i] > 100)
+      x |= 1 << i;
+
+  return x;
+}
@@ -0,0 +1,20 @@
+// RUN: %llvmgcc -emit-llvm -g -c -o %t1.bc %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-telemetry %t1.bc 2> %t.log
+// RUN: grep "completed paths = 3" %t.log
+// RUN: grep "^layer: independent" %t.klee-out/solver-telemetry.txt
+// RUN: grep "^layer: cache" %t.klee-out/solver-telemetry.txt
+// RUN: grep "^layer: cex-cache" %t.klee-out/solver-telemetry.txt
+// RUN: grep "^layer: core" %t.klee-out/solver-telemetry.txt
+// RUN: grep -A2 "^layer: cache" %t.klee-out/solver-telemetry.txt | grep "hits:"
+// RUN: grep -A2 "^layer: core" %t.klee-out/solver-telemetry.txt | not grep "hits:"
+
+int main() {
+  int x = klee_int("x");
+
+  if (x > 10)
+    return 1;
+  if (x < -10)
+    return 2;
+  return 0;
+}
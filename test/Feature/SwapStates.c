@@ -0,0 +1,34 @@
+// Check that states over the memory cap are suspended to disk and resumed,
+// rather than killed, with --swap-states.
+
+// RUN: %llvmgcc -emit-llvm -g -c %s -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-memory=20 --max-memory-inhibit=false --swap-states %t.bc 2> %t.err
+// RUN: grep "WARNING: suspending" %t.err
+// RUN: not grep "killing" %t.err
+// RUN: grep "completed paths = 16" %t.err
+
+#include <stdlib.h>
+
+int main() {
+  unsigned char buf[4];
+  unsigned i, j, x = 0;
+
+  klee_make_symbolic(buf, sizeof buf, "buf");
+
+  // 16 states
+  for (i = 0; i < 4; i++)
+    if (buf[i] > 100)
+      x |= 1 << i;
+
+  // each owning 8 MBs, written so they are not shared
+  for (i = 0; i < 8; i++) {
+    char *p = malloc(1 << 20);
+    p[0] = x;
+    // Ensure we hit the periodic check
+    for (j = 0; j < 10000; j++)
+      x += p[0];
+  }
+
+  return x;
+}
@@ -0,0 +1,17 @@
+// RUN: %llvmgcc -emit-llvm -g -c %s -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --track-instruction-time %t.bc 2> %t.err
+// RUN: grep "completed paths = 2" %t.err
+// RUN: grep "^event: Ireal" %t.klee-out/run.istats
+// RUN: rm -rf %t.klee-out2
+// RUN: %klee --output-dir=%t.klee-out2 --track-instruction-time --instruction-time-sample-interval=0 %t.bc 2> %t.err2
+// RUN: grep "completed paths = 2" %t.err2
+// RUN: grep "^event: Ireal" %t.klee-out2/run.istats
+
+int main() {
+  int x = klee_int("x");
+
+  if (x > 10)
+    return 1;
+  return 0;
+}
@@ -367,6 +367,11 @@ static bool EvaluateInputAST(const char *Filename,
       << *theStatisticManager->getStatisticByName("QueriesCEX") << "\n";
   }
 
+  if (UseSolverTelemetry) {
+    llvm::outs() << "--\n";
+    writeSolverTelemetry(llvm::outs());
+  }
+
   return success;
 }
 
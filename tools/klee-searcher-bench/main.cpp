@@ -0,0 +1,380 @@
+//===-- main.cpp ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures the cost of searchers in isolation. The searcher is fed either
+// the updates recorded by klee --write-searcher-trace, or those of a
+// synthetic run which forks and terminates states at random. The states
+// are empty apart from the fields the searchers read, so only searchers
+// which do not need a module are supported.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CoreStats.h"
+#include "Executor.h"
+#include "PTree.h"
+#include "Searcher.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Interpreter.h"
+#include "klee/Statistics.h"
+#include "klee/Internal/ADT/RNG.h"
+#include "klee/Internal/System/MemoryUsage.h"
+#include "klee/Internal/System/Time.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+  cl::opt<std::string>
+  TraceFile(cl::desc("<searcher trace>"), cl::Positional, cl::init(""));
+
+  cl::list<Searcher::CoreSearchType>
+  SearcherTypes("searcher",
+                cl::desc("Searcher to benchmark, several are interleaved (default=random-path)"),
+                cl::values(clEnumValN(Searcher::DFS, "dfs", "Depth First Search"),
+                           clEnumValN(Searcher::BFS, "bfs", "Breadth First Search"),
+                           clEnumValN(Searcher::RandomState, "random-state", "Random State Selection"),
+                           clEnumValN(Searcher::RandomPath, "random-path", "Random Path Selection"),
+                           clEnumValN(Searcher::RandomPath_QC, "random-path:qc", "Random Path Selection weighted by Query-Cost"),
+                           clEnumValN(Searcher::NURS_Depth, "nurs:depth", "NURS with 2^depth"),
+                           clEnumValN(Searcher::NURS_QC, "nurs:qc", "NURS with Query-Cost"),
+                           clEnumValEnd));
+
+  cl::opt<unsigned>
+  BatchSteps("batch-steps",
+             cl::desc("Keep the selected state for this many steps, as --use-batching-search does (default=0 (off))"),
+             cl::init(0));
+
+  cl::opt<unsigned>
+  SyntheticStates("synthetic-states",
+                  cl::desc("Number of states the synthetic run grows to and keeps (default=100000)"),
+                  cl::init(100000));
+
+  cl::opt<unsigned>
+  SyntheticSteps("synthetic-steps",
+                 cl::desc("Number of steps of the synthetic run (default=1000000)"),
+                 cl::init(1000000));
+
+  cl::opt<unsigned>
+  RNGSeed("rng-seed",
+          cl::desc("Seed of the searchers and of the synthetic run (default=1)"),
+          cl::init(1));
+
+  /// The executor is only needed as the owner of the states and of the
+  /// process tree; nothing is written.
+  class NullHandler : public InterpreterHandler {
+  public:
+    raw_ostream &getInfoStream() const { return nulls(); }
+    std::string getOutputFilename(const std::string &filename) {
+      return filename;
+    }
+    raw_fd_ostream *openOutputFile(const std::string &filename) { return 0; }
+    void incPathsExplored() {}
+    void processTestCase(const ExecutionState &state, const char *err,
+                         const char *suffix) {}
+  };
+
+  class Latency {
+    uint64_t calls;
+    double total, max;
+
+  public:
+    Latency() : calls(0), total(0.), max(0.) {}
+
+    void add(double time) {
+      ++calls;
+      total += time;
+      max = std::max(max, time);
+    }
+
+    void print(raw_ostream &os, const char *name) const {
+      os << name << ": " << calls << " calls, " << total << " s, "
+         << (calls ? total / calls * 1e9 : 0.) << " ns mean, "
+         << max * 1e6 << " us max\n";
+    }
+  };
+}
+
+namespace klee {
+  extern RNG theRNG;
+
+  /// SearcherBenchmark - Drives a searcher the way the executor does,
+  /// owning the states and the process tree through \ref Executor.
+  class SearcherBenchmark {
+    Executor &executor;
+    Searcher *searcher;
+    std::set<ExecutionState*> addedStates, removedStates;
+
+    Latency selectLatency, updateLatency;
+    uint64_t steps;
+    size_t peakStates, baseMemory, peakMemory;
+
+    ExecutionState *addState(ExecutionState *parent);
+    ExecutionState &selectState();
+    void updateStates(ExecutionState *current);
+    void sampleMemory();
+
+  public:
+    SearcherBenchmark(Executor &_executor, Searcher *_searcher);
+    ~SearcherBenchmark();
+
+    bool runTrace(const std::string &path, std::string &error);
+    void runSynthetic(unsigned numStates, unsigned numSteps);
+    void print(raw_ostream &os);
+  };
+}
+
+SearcherBenchmark::SearcherBenchmark(Executor &_executor, Searcher *_searcher)
+  : executor(_executor), searcher(_searcher), steps(0), peakStates(0),
+    baseMemory(util::GetTotalMallocUsage()), peakMemory(baseMemory) {}
+
+SearcherBenchmark::~SearcherBenchmark() {
+  delete searcher;
+  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
+         ie = executor.states.end(); it != ie; ++it)
+    delete *it;
+  executor.states.clear();
+}
+
+ExecutionState *SearcherBenchmark::addState(ExecutionState *parent) {
+  if (parent) {
+    ExecutionState *es = parent->branch();
+    parent->ptreeNode->data = 0;
+    std::pair<PTree::Node*, PTree::Node*> res =
+      executor.processTree->split(parent->ptreeNode, es, parent);
+    es->ptreeNode = res.first;
+    parent->ptreeNode = res.second;
+    return es;
+  }
+
+  ExecutionState *es = new ExecutionState(std::vector<ref<Expr> >());
+  es->weight = 1.;
+  es->depth = 0;
+  es->instsSinceCovNew = 0;
+  es->coveredNew = false;
+  es->forkDisabled = false;
+  if (executor.processTree) {
+    es->ptreeNode = executor.processTree->insert(es);
+  } else {
+    executor.processTree = new PTree(es);
+    es->ptreeNode = executor.processTree->root;
+  }
+  return es;
+}
+
+ExecutionState &SearcherBenchmark::selectState() {
+  double start = util::getWallTime();
+  ExecutionState &es = searcher->selectState();
+  selectLatency.add(util::getWallTime() - start);
+  ++stats::instructions;
+  return es;
+}
+
+void SearcherBenchmark::updateStates(ExecutionState *current) {
+  double start = util::getWallTime();
+  searcher->update(current, addedStates, removedStates);
+  updateLatency.add(util::getWallTime() - start);
+
+  executor.states.insert(addedStates.begin(), addedStates.end());
+  addedStates.clear();
+
+  for (std::set<ExecutionState*>::iterator it = removedStates.begin(),
+         ie = removedStates.end(); it != ie; ++it) {
+    ExecutionState *es = *it;
+    executor.states.erase(es);
+    executor.processTree->remove(es->ptreeNode);
+    delete es;
+  }
+  removedStates.clear();
+
+  peakStates = std::max(peakStates, executor.states.size());
+  // Reading the malloc statistics is not free, do it periodically.
+  if ((++steps & 0xFFF) == 0)
+    sampleMemory();
+}
+
+void SearcherBenchmark::sampleMemory() {
+  peakMemory = std::max(peakMemory, util::GetTotalMallocUsage());
+}
+
+bool SearcherBenchmark::runTrace(const std::string &path,
+                                 std::string &error) {
+  std::ifstream in(path.c_str());
+  if (!in) {
+    error = "unable to open " + path;
+    return false;
+  }
+
+  std::map<unsigned, ExecutionState*> traced;
+  ExecutionState *current = 0;
+  std::string line;
+  for (unsigned lineNo = 1; std::getline(in, line); ++lineNo) {
+    unsigned id, parent, depth;
+    unsigned long long count;
+    double queryCost;
+    ExecutionState *es = 0;
+
+    if (std::sscanf(line.c_str(), "s %u %llu %u %lf",
+                    &id, &count, &depth, &queryCost) == 4) {
+      updateStates(current);
+      if (!traced.count(id))
+        goto invalid;
+      current = traced[id];
+      // The searcher chooses for itself, the trace decides which state
+      // steps and how it changes.
+      for (unsigned long long i = 0; i != count; ++i) {
+        if (i)
+          updateStates(current);
+        if (!searcher->empty())
+          selectState();
+      }
+      current->depth = depth;
+      current->queryCost = queryCost;
+    } else if (std::sscanf(line.c_str(), "a %u %u", &id, &parent) == 2) {
+      if (parent) {
+        if (!traced.count(parent))
+          goto invalid;
+        es = traced[parent];
+      }
+      es = addState(es);
+      traced[id] = es;
+      addedStates.insert(es);
+    } else if (std::sscanf(line.c_str(), "r %u", &id) == 1) {
+      std::map<unsigned, ExecutionState*>::iterator it = traced.find(id);
+      if (it == traced.end())
+        goto invalid;
+      removedStates.insert(it->second);
+      traced.erase(it);
+    } else {
+      goto invalid;
+    }
+    continue;
+
+  invalid:
+    char buffer[32];
+    std::sprintf(buffer, "%u", lineNo);
+    error = path + ":" + buffer + ": invalid trace line";
+    return false;
+  }
+
+  updateStates(current);
+  sampleMemory();
+  return true;
+}
+
+void SearcherBenchmark::runSynthetic(unsigned numStates, unsigned numSteps) {
+  RNG rng(RNGSeed);
+
+  addedStates.insert(addState(0));
+  updateStates(0);
+
+  for (unsigned i = 0; i != numSteps && !searcher->empty(); ++i) {
+    ExecutionState &es = selectState();
+    unsigned roll = rng.getInt32() % 100;
+
+    // Grow to the requested number of states, then fork and terminate
+    // at the same rate.
+    if (executor.states.size() < numStates) {
+      if (roll < 50)
+        addedStates.insert(addState(&es));
+    } else if (roll < 5) {
+      addedStates.insert(addState(&es));
+    } else if (roll < 10) {
+      removedStates.insert(&es);
+    }
+
+    if (roll >= 90)
+      es.queryCost += rng.getDoubleL();
+
+    updateStates(&es);
+  }
+
+  sampleMemory();
+}
+
+void SearcherBenchmark::print(raw_ostream &os) {
+  searcher->printName(os);
+  os << "steps: " << steps << "\n"
+     << "peak states: " << peakStates << "\n";
+  selectLatency.print(os, "selectState");
+  updateLatency.print(os, "update");
+  os << "peak memory: " << ((peakMemory - baseMemory) >> 20) << " MB\n";
+}
+
+static Searcher *createSearcher(Searcher::CoreSearchType type,
+                                Executor &executor) {
+  switch (type) {
+  case Searcher::DFS: return new DFSSearcher();
+  case Searcher::BFS: return new BFSSearcher();
+  case Searcher::RandomState: return new RandomSearcher();
+  case Searcher::RandomPath_QC:
+    return new WeightedRandomPathSearcher(executor,
+                                          WeightedRandomPathSearcher::QueryCost);
+  case Searcher::NURS_Depth:
+    return new WeightedRandomSearcher(WeightedRandomSearcher::Depth);
+  case Searcher::NURS_QC:
+    return new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost);
+  default:
+    return new RandomPathSearcher(executor);
+  }
+}
+
+int main(int argc, char **argv) {
+  llvm::sys::PrintStackTraceOnErrorSignal();
+  llvm::cl::ParseCommandLineOptions(argc, argv, "KLEE searcher benchmark\n");
+
+  theRNG.seed(RNGSeed);
+
+  NullHandler handler;
+  Interpreter::InterpreterOptions opts;
+  Executor *executor =
+    static_cast<Executor*>(Interpreter::create(opts, &handler));
+
+  if (SearcherTypes.empty())
+    SearcherTypes.push_back(Searcher::RandomPath);
+  Searcher *searcher = createSearcher(SearcherTypes[0], *executor);
+  if (SearcherTypes.size() > 1) {
+    std::vector<Searcher*> searchers;
+    searchers.push_back(searcher);
+    for (unsigned i = 1; i < SearcherTypes.size(); ++i)
+      searchers.push_back(createSearcher(SearcherTypes[i], *executor));
+    searcher = new InterleavedSearcher(searchers);
+  }
+  if (BatchSteps)
+    searcher = new BatchingSearcher(searcher, 1e30, BatchSteps);
+
+  int result = 0;
+  {
+    SearcherBenchmark benchmark(*executor, searcher);
+    std::string error;
+    if (TraceFile.empty()) {
+      benchmark.runSynthetic(SyntheticStates, SyntheticSteps);
+    } else if (!benchmark.runTrace(TraceFile, error)) {
+      errs() << "klee-searcher-bench: " << error << "\n";
+      result = 1;
+    }
+    if (!result)
+      benchmark.print(outs());
+  }
+
+  delete executor;
+  return result;
+}
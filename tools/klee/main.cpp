@@ -1369,6 +1369,9 @@ int main(int argc, char **argv, char **envp) {
     interpreter->setModule(mainModule, Opts);
   externalsAndGlobalsCheck(finalModule);
 
+  // The module may have been replaced by a cached prepared one.
+  mainFn = finalModule->getFunction("main");
+
   if (ReplayPathFile != "") {
     interpreter->setReplayPath(&replayPath);
   }
@@ -13,6 +13,7 @@
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/Solver.h"
+#include "klee/SolverImpl.h"
 #include "llvm/ADT/StringExtras.h"
 
 using namespace klee;
@@ -26,6 +27,45 @@ const Expr::Width g_types[] = { Expr::Bool,
 				Expr::Int32,
 				Expr::Int64 };
 
+/// A solver which answers getInitialValues from a fixed assignment and
+/// counts the queries reaching it.
+class CountingSolverImpl : public SolverImpl {
+public:
+  std::map<const Array*, unsigned char> model;
+  unsigned valueQueries;
+  unsigned initialValuesQueries;
+
+  CountingSolverImpl() : valueQueries(0), initialValuesQueries(0) {}
+
+  bool computeTruth(const Query&, bool &isValid) {
+    isValid = false;
+    return true;
+  }
+
+  bool computeValue(const Query& query, ref<Expr> &result) {
+    ++valueQueries;
+    result = ConstantExpr::alloc(0, query.expr->getWidth());
+    return true;
+  }
+
+  bool computeInitialValues(const Query&,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    ++initialValuesQueries;
+    values.clear();
+    for (unsigned i = 0; i != objects.size(); ++i)
+      values.push_back(std::vector<unsigned char>(objects[i]->size,
+                                                  model[objects[i]]));
+    hasSolution = true;
+    return true;
+  }
+
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
 ref<Expr> getConstant(int value, Expr::Width width) {
   int64_t ext = value;
   uint64_t trunc = ext & (((uint64_t) -1LL) >> (64 - width));
@@ -161,4 +201,121 @@ TEST(SolverTest, Evaluation) {
   delete solver;
 }
 
+TEST(SolverTest, BatchedMayBeTrue) {
+  STPSolver *stpSolver = new STPSolver(true); 
+  Solver *solver = stpSolver;
+
+  solver = createCachingSolver(solver);
+  solver = createIndependentSolver(solver);
+
+  const Array *array = Array::CreateArray("batch", 1);
+  ref<Expr> x = Expr::createTempRead(array, Expr::Int8);
+
+  // x < 10
+  ConstraintManager constraints;
+  constraints.addConstraint(UltExpr::create(x, getConstant(10, Expr::Int8)));
+
+  std::vector< ref<Expr> > exprs;
+  exprs.push_back(EqExpr::create(x, getConstant(3, Expr::Int8)));
+  exprs.push_back(EqExpr::create(x, getConstant(12, Expr::Int8)));
+  exprs.push_back(UltExpr::create(x, getConstant(20, Expr::Int8)));
+  exprs.push_back(EqExpr::create(x, getConstant(9, Expr::Int8)));
+  exprs.push_back(ConstantExpr::alloc(0, Expr::Bool));
+
+  std::vector<bool> results;
+  EXPECT_TRUE(solver->mayBeTrue(constraints, exprs, results));
+  ASSERT_EQ(exprs.size(), results.size());
+  EXPECT_TRUE(results[0]);
+  EXPECT_FALSE(results[1]);
+  EXPECT_TRUE(results[2]);
+  EXPECT_TRUE(results[3]);
+  EXPECT_FALSE(results[4]);
+
+  EXPECT_TRUE(solver->mustBeTrue(constraints, exprs, results));
+  ASSERT_EQ(exprs.size(), results.size());
+  EXPECT_FALSE(results[0]);
+  EXPECT_FALSE(results[1]);
+  EXPECT_TRUE(results[2]);
+  EXPECT_FALSE(results[3]);
+  EXPECT_FALSE(results[4]);
+
+  delete solver;
+}
+
+TEST(SolverTest, CachedModelValue) {
+  CountingSolverImpl *counter = new CountingSolverImpl();
+  Solver *solver = createCachingSolver(new Solver(counter));
+
+  const Array *array = Array::CreateArray("model", 1);
+  ref<Expr> x = Expr::createTempRead(array, Expr::Int8);
+  counter->model[array] = 3;
+
+  // x < 10
+  ConstraintManager constraints;
+  constraints.addConstraint(UltExpr::create(x, getConstant(10, Expr::Int8)));
+
+  std::vector<const Array*> objects(1, array);
+  std::vector< std::vector<unsigned char> > values;
+  EXPECT_TRUE(solver->getInitialValues(Query(constraints,
+                                             ConstantExpr::alloc(0, Expr::Bool)),
+                                       objects, values));
+  EXPECT_EQ(1u, counter->initialValuesQueries);
+
+  // Answered by evaluating x + 1 under the cached model.
+  ref<ConstantExpr> value;
+  EXPECT_TRUE(solver->getValue(Query(constraints,
+                                     AddExpr::create(x,
+                                                     getConstant(1, Expr::Int8))),
+                               value));
+  EXPECT_EQ(4u, value->getZExtValue());
+  EXPECT_EQ(0u, counter->valueQueries);
+
+  // The same model serves a second request for the same objects.
+  EXPECT_TRUE(solver->getInitialValues(Query(constraints,
+                                             ConstantExpr::alloc(0, Expr::Bool)),
+                                       objects, values));
+  EXPECT_EQ(1u, counter->initialValuesQueries);
+
+  delete solver;
+}
+
+TEST(SolverTest, StaleCachedModel) {
+  CountingSolverImpl *counter = new CountingSolverImpl();
+  Solver *solver = createCachingSolver(new Solver(counter));
+
+  const Array *arrayX = Array::CreateArray("stale_x", 1);
+  const Array *arrayY = Array::CreateArray("stale_y", 1);
+  ref<Expr> x = Expr::createTempRead(arrayX, Expr::Int8);
+  ref<Expr> y = Expr::createTempRead(arrayY, Expr::Int8);
+  counter->model[arrayX] = 3;
+  counter->model[arrayY] = 7;
+
+  // x < 10 && y > 5
+  ConstraintManager constraints;
+  constraints.addConstraint(UltExpr::create(x, getConstant(10, Expr::Int8)));
+  constraints.addConstraint(UgtExpr::create(y, getConstant(5, Expr::Int8)));
+
+  // The cached model only binds x, and y = 0 violates the constraints.
+  std::vector<const Array*> objects(1, arrayX);
+  std::vector< std::vector<unsigned char> > values;
+  EXPECT_TRUE(solver->getInitialValues(Query(constraints,
+                                             ConstantExpr::alloc(0, Expr::Bool)),
+                                       objects, values));
+  EXPECT_EQ(1u, counter->initialValuesQueries);
+
+  ref<ConstantExpr> value;
+  EXPECT_TRUE(solver->getValue(Query(constraints, x), value));
+  EXPECT_EQ(1u, counter->valueQueries);
+
+  objects.push_back(arrayY);
+  EXPECT_TRUE(solver->getInitialValues(Query(constraints,
+                                             ConstantExpr::alloc(0, Expr::Bool)),
+                                       objects, values));
+  EXPECT_EQ(2u, counter->initialValuesQueries);
+  ASSERT_EQ(2u, values.size());
+  EXPECT_EQ(7u, values[1][0]);
+
+  delete solver;
+}
+
 }